@@ -45,6 +45,9 @@ void XmoduleExample::saveCfgCallback(){
 
 void XmoduleExample::someAction() {
     mvp.logger.write(CfgLogger::INFO, "Some action performed.");
+    // Remember the time for the list on the web page, the oldest is overwritten
+    actionTimes[actionCount % 3] = millis();
+    actionCount++;
 }
 
 
@@ -60,28 +63,27 @@ String XmoduleExample::webPageProcessor(uint8_t var)  {
             return String(cfgXmoduleExample.fixedNumber);
         case 102:
             return String(cfgXmoduleExample.editableNumber);
-
-        // case 150: // Split long strings into multiple parts
-        //     // Check if list is empty
-        //     if (linkedListExample.getSize() == 0) {
-        //         return "<li>None</li>";
-        //     }
-        //     // Set initial bookmark
-        //     linkedListExample.bookmarkByIndex(0, true);
-        // case 151:
-        //     return _helper.printFormatted("<li>%s</li> %s", linkedListExample.getBookmarkData()->getDataTopic().c_str(),
-        //         (linkedListExample.moveBookmark()) ? "%151%" : "");
+        case 103: // Only called if the list has no rows
+            return "<li>None</li>";
 
         default:
-            //  Capture all
-            // The placeholder string can hold a secondary placeholder which then is also filled, and so on.
-            // if (var.toInt() < 50) {
-            //     return "added a placeholder ( %" + String(var.toInt() + 1) + "% )";
-            // } else {
-            //     return "stop this madness!!!";
-            // }
-            //  Or log an unknown placeholder value
-            // mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "Unknown placeholder in template: %s", var.c_str());
+            // Values are inserted as they are, placeholders in them are not filled
+            //  Log an unknown placeholder value
+            // mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "Unknown placeholder in template: %d", var);
             return str;
     }
+}
+
+boolean XmoduleExample::webPageListProcessor(uint8_t var, uint16_t index, String& row) {
+    // Long lists are split into rows, called with increasing index until it returns false
+    switch (var) {
+        case 103: // Times of the recent actions, newest first
+            if (index >= min(actionCount, (uint8_t)3))
+                return false;
+            row = "<li>" + _helper.millisToTime(actionTimes[(actionCount - 1 - index) % 3]) + "</li>";
+            return true;
+
+        default:
+            return false;
+    }
 }
\ No newline at end of file
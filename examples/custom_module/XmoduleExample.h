@@ -62,9 +62,12 @@ class XmoduleExample : public _Xmodule {
 
         // Module custom methods
         void someAction();
+        uint32_t actionTimes[3];
+        uint8_t actionCount = 0;
 
         // Web interface
         String webPageProcessor(uint8_t var) override;
+        boolean webPageListProcessor(uint8_t var, uint16_t index, String& row) override;
 
         // We cannot override the values, but we can override this function.
         const char*  getWebPage() override { return R"===(%0%
@@ -74,7 +77,8 @@ class XmoduleExample : public _Xmodule {
     <li>Some fixed number: %101% </li>
     <li>Some editable number:<br> <form action='/save' method='post'> <input name='editableNumber' value='%102%' type='number' min='11112' max='65535'> <input type='submit' value='Save'> </form> </li> </ul>
 <h3>Action</h3> <ul>
-    <li>Perform some action:<br> <form action='/start' method='post'> <input name='someAction' type='hidden'> <input type='submit' value='Action'> </form> </li> </ul>
+    <li>Perform some action:<br> <form action='/start' method='post'> <input name='someAction' type='hidden'> <input type='submit' value='Action'> </form> </li>
+    <li>Recent actions: <ul> %103% </ul> </li> </ul>
 %9%)==="; }
 
 };
@@ -0,0 +1,95 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+#include <MVP3000.h>
+extern MVP3000 mvp;
+
+#include "_Helper.h"
+extern _Helper _helper;
+
+// Compares printf-style formatting into a String with the fixed-buffer StringBuilder
+// The results are printed to the log every 5 s, the StringBuilder does not allocate memory
+// extras/test/format_benchmark.cpp runs the same comparison on a PC and counts the allocations
+
+const uint16_t rounds = 1000;
+const uint8_t valueCount = 100;
+
+int32_t data[valueCount];
+
+LimitTimer timer(5000);
+
+void setup() {
+    for (uint8_t i = 0; i < valueCount; i++) {
+        data[i] = 10000 + random(1000) + 100 * i;
+    }
+
+    mvp.setup();
+}
+
+void loop() {
+    mvp.loop();
+
+    if (timer.justFinished()) {
+        benchmarkRow();
+        benchmarkCsv();
+    }
+}
+
+// A typical web page row with time and numbers
+void benchmarkRow() {
+    uint32_t start_us = micros();
+    size_t check = 0;
+    for (uint16_t i = 0; i < rounds; i++) {
+        String row = _helper.printFormatted("<li>%s %d / %d</li> ", _helper.millisToTime(millis()).c_str(), i, ESP.getFreeHeap());
+        check += row.length();
+    }
+    uint32_t printFormatted_us = micros() - start_us;
+
+    start_us = micros();
+    for (uint16_t i = 0; i < rounds; i++) {
+        StringBuffer<64> row;
+        row.append("<li>").appendTime(millis()).append(' ').appendUint(i).append(" / ").appendUint(ESP.getFreeHeap()).append("</li> ");
+        check -= row.length();
+    }
+    uint32_t builder_us = micros() - start_us;
+
+    mvp.logger.writeFormatted(CfgLogger::Level::USER, "Row: printFormatted %lu ns, StringBuilder %lu ns per row%s", (unsigned long)(printFormatted_us * 1000UL / rounds), (unsigned long)(builder_us * 1000UL / rounds), (check != 0) ? ", output differs" : "");
+}
+
+// A sensor sample as CSV
+void benchmarkCsv() {
+    char buffer[12 * valueCount + 1];
+
+    uint32_t start_us = micros();
+    for (uint16_t i = 0; i < rounds / 10; i++) {
+        size_t len = 0;
+        for (uint8_t j = 0; j < valueCount; j++)
+            len += snprintf(buffer + len, sizeof(buffer) - len, "%ld%c", (long)data[j], (j == valueCount - 1) ? ';' : ',');
+    }
+    uint32_t snprintf_us = micros() - start_us;
+
+    start_us = micros();
+    for (uint16_t i = 0; i < rounds / 10; i++) {
+        StringBuilder csv(buffer, sizeof(buffer));
+        for (uint8_t j = 0; j < valueCount; j++)
+            csv.appendInt(data[j]).append((j == valueCount - 1) ? ';' : ',');
+    }
+    uint32_t builder_us = micros() - start_us;
+
+    mvp.logger.writeFormatted(CfgLogger::Level::USER, "CSV of %d values: snprintf %lu us, StringBuilder %lu us per line", valueCount, (unsigned long)(snprintf_us * 10 / rounds), (unsigned long)(builder_us * 10 / rounds));
+}
@@ -0,0 +1,84 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+// Channel count and sample rate, change here or set as build flag, for example -D BENCHMARK_RATE_HZ=200
+#ifndef BENCHMARK_CHANNELS
+    #define BENCHMARK_CHANNELS 100 // 1-255
+#endif
+#ifndef BENCHMARK_COLUMNS
+    #define BENCHMARK_COLUMNS 10 // Channels per row of the matrix on the web page
+#endif
+#ifndef BENCHMARK_RATE_HZ
+    #define BENCHMARK_RATE_HZ 100 // Samples per second, 1-1000
+#endif
+
+#include <MVP3000.h>
+extern MVP3000 mvp;
+
+// Synthetic sensor to measure MQTT throughput, use with mqtt_benchmark.py on the receiving side
+// Set sample averaging to 1 in the web interface, otherwise the output rate is the sample rate divided by the averaging
+// The output encoding (CSV, CBOR) and the MQTT settings (QoS, queue, window) are set in the web interface as well
+
+const uint8_t valueCount = BENCHMARK_CHANNELS;
+const uint8_t columns = BENCHMARK_COLUMNS;
+uint32_t measurementInterval_ms = 1000 / BENCHMARK_RATE_HZ;
+
+String infoName = "BENCHMARK";
+String infoDescription = "The BENCHMARK is a dummy sensor generating 'data' at a fixed rate to measure the MQTT throughput.";
+String pixelType = "channel";
+String pixelUnit = "counts";
+
+// Local data variable
+int32_t data[valueCount];
+
+// Init sensor module
+XmoduleSensor xmoduleSensor(valueCount);
+
+void setup() {
+    xmoduleSensor.setSensorInfo(infoName, infoDescription, pixelType, pixelUnit, columns);
+
+    // Add the sensor module to the mvp framework
+    mvp.addXmodule(&xmoduleSensor);
+
+    // Start mvp framework
+    mvp.setup();
+}
+
+void loop() {
+    // Do the work
+    mvp.loop();
+
+    if (fakeSensorReady()) {
+        // Values of typical magnitude so the payload size is realistic
+        for (uint8_t i = 0; i < valueCount; i++) {
+            data[i] = 10000 + random(1000) + 100 * i;
+        }
+        xmoduleSensor.addSample(data);
+    }
+
+    // IMPORTANT: Do not ever use blocking delay() in actual code
+}
+
+
+uint32_t nextMeasurement_ms = 0;
+bool fakeSensorReady() {
+    if (millis() > nextMeasurement_ms) {
+        nextMeasurement_ms = millis() + measurementInterval_ms;
+        return true;
+    }
+    return false;
+}
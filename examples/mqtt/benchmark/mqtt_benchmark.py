@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+#
+# Copyright Production 3000
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+MQTT throughput and latency benchmark for the sensor module.
+
+Subscribes to DEVICEID_sensor_data on a (local) broker and reports per interval:
+messages/s, gaps in the sequence number (CBOR only), payload and wire bytes/s,
+and p50/p99 of the publish-to-receive latency.
+
+The device time is milliseconds since boot, so latency is relative: the lowest
+observed receive-minus-device time is taken as zero. It includes queueing on the
+device, the network, and the broker. Use a broker on the local network to keep
+the broker share small, for example mosquitto.
+
+    pip install paho-mqtt
+    mosquitto -v
+    python3 mqtt_benchmark.py --broker 192.168.1.10 --device 1234567 --interval 5
+
+The wire bytes are those the device sends to the broker. Set --publish-qos to
+the QoS set on the device, the subscription QoS only applies to the broker side.
+
+Use with the benchmark.ino sketch or any other sensor example.
+"""
+
+import argparse
+import threading
+import time
+
+import paho.mqtt.client as mqtt
+
+
+def decode_cbor(data):
+    """Decode the CBOR subset written by the device: integers, text, arrays, maps."""
+    pos = 0
+
+    def read_length(info):
+        nonlocal pos
+        if info < 24:
+            return info
+        size = {24: 1, 25: 2, 26: 4, 27: 8}[info]
+        value = int.from_bytes(data[pos:pos + size], 'big')
+        pos += size
+        return value
+
+    def read_item():
+        nonlocal pos
+        initial = data[pos]
+        pos += 1
+        major, value = initial >> 5, read_length(initial & 0x1F)
+        if major == 0:
+            return value
+        if major == 1:
+            return -1 - value
+        if major == 3:
+            text = data[pos:pos + value].decode()
+            pos += value
+            return text
+        if major == 4:
+            return [read_item() for _ in range(value)]
+        if major == 5:
+            return {read_item(): read_item() for _ in range(value)}
+        raise ValueError('Unsupported CBOR type %d' % major)
+
+    return read_item()
+
+
+def parse_payload(payload):
+    """Return (seq, device time) of a sensor message, seq is None for CSV."""
+    if payload[:1] == b'\xa4':  # CBOR map of 4 entries
+        data = decode_cbor(payload)
+        return data['s'], data['t']
+    return None, int(payload.split(b';', 1)[0])
+
+
+def wire_size(topic_length, payload_length, qos):
+    """Size of the PUBLISH packet: fixed header, remaining length, topic, packet id, payload."""
+    remaining = 2 + topic_length + (2 if qos > 0 else 0) + payload_length
+    length_bytes = 1
+    while remaining >= 128 ** length_bytes:
+        length_bytes += 1
+    return 1 + length_bytes + remaining
+
+
+def percentile(values, p):
+    if not values:
+        return float('nan')
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+class Benchmark:
+
+    def __init__(self, interval, publish_qos):
+        self.interval = interval
+        self.publish_qos = publish_qos  # Of the device, the received QoS is the lower of it and the subscription QoS
+        self.min_offset = None
+        self.last_seq = None
+        self.lock = threading.Lock()  # Messages arrive in the network thread
+        self.reset()
+        self.next_report = time.monotonic() + interval
+
+    def reset(self):
+        self.messages = 0
+        self.gaps = 0
+        self.payload_bytes = 0
+        self.wire_bytes = 0
+        self.offsets = []
+
+    def on_message(self, client, userdata, msg):
+        recv_ms = time.time() * 1000
+        seq, device_ms = parse_payload(msg.payload)
+        with self.lock:
+            self.count(msg, recv_ms, seq, device_ms)
+
+    def count(self, msg, recv_ms, seq, device_ms):
+        self.messages += 1
+        self.payload_bytes += len(msg.payload)
+        self.wire_bytes += wire_size(len(msg.topic), len(msg.payload), self.publish_qos)
+
+        if (seq is not None) and (self.last_seq is not None) and (seq > self.last_seq + 1):
+            self.gaps += seq - self.last_seq - 1
+        self.last_seq = seq
+
+        offset = recv_ms - device_ms
+        self.min_offset = offset if self.min_offset is None else min(self.min_offset, offset)
+        self.offsets.append(offset)
+
+    def report(self):
+        if time.monotonic() < self.next_report:
+            return
+        self.next_report += self.interval
+        with self.lock:
+            self.print_report()
+            self.reset()
+
+    def print_report(self):
+        if not self.offsets:
+            print('No messages')
+            return
+        latency = [o - self.min_offset for o in self.offsets]
+        print('%7.1f msg/s  %5d lost  %9.0f B/s payload  %9.0f B/s wire  latency p50 %6.1f ms  p99 %6.1f ms' % (
+            self.messages / self.interval, self.gaps,
+            self.payload_bytes / self.interval, self.wire_bytes / self.interval,
+            percentile(latency, 50), percentile(latency, 99)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='MQTT throughput and latency benchmark for the sensor module.')
+    parser.add_argument('--broker', default='localhost', help='broker host')
+    parser.add_argument('--port', type=int, default=1883, help='broker port')
+    parser.add_argument('--device', required=True, help='device id, the topic prefix')
+    parser.add_argument('--qos', type=int, default=0, choices=[0, 1], help='subscription QoS')
+    parser.add_argument('--publish-qos', type=int, default=0, choices=[0, 1], help='QoS set on the device, for the wire bytes')
+    parser.add_argument('--interval', type=float, default=5, help='report interval in seconds')
+    args = parser.parse_args()
+
+    benchmark = Benchmark(args.interval, args.publish_qos)
+
+    if hasattr(mqtt, 'CallbackAPIVersion'):  # paho-mqtt 2.x
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    else:
+        client = mqtt.Client()
+    client.on_message = benchmark.on_message
+    client.connect(args.broker, args.port)
+    client.subscribe(args.device + '_sensor_data', args.qos)
+
+    print('Subscribed to %s_sensor_data on %s:%d' % (args.device, args.broker, args.port))
+    client.loop_start()
+    try:
+        while True:
+            time.sleep(0.1)
+            benchmark.report()
+    except KeyboardInterrupt:
+        pass
+    client.loop_stop()
+
+
+if __name__ == '__main__':
+    main()
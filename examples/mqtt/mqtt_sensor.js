@@ -48,7 +48,13 @@ function connect() {
     }
 
     client.onMessageArrived = function(e) {
-        document.getElementById('data').innerHTML = e.payloadString;
+        // CBOR encoded sensor data is a map of 4 entries, CSV starts with a digit
+        if (e.payloadBytes[0] == 0xA4) {
+            let data = decodeSensorData(e.payloadBytes);
+            document.getElementById('data').innerHTML = "#" + data.seq + " " + sensorDataToCsv(data);
+        } else {
+            document.getElementById('data').innerHTML = e.payloadString;
+        }
     }
 
     // For some reason the onConnect needs to be passed here and cannot be defined separately like the others
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+#
+# Copyright Production 3000
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Decoder for the binary serial output of the sensor module.
+
+Select binary frames on the sensor page. Each measurement is then written as a
+COBS encoded frame between zero bytes:
+
+    type (1), seq (4), time ms (4), column count (1), value count (1),
+    values (int32, 4 each), CRC-32 (4), all little-endian
+
+Log text still arrives on the same port between the frames and is printed as is.
+Frames are checked for the CRC and gaps in the sequence number. The values are
+printed as CSV, or written to a file with --csv, and rates are reported per
+interval.
+
+    pip install pyserial
+    python3 serial_decoder.py --port /dev/ttyUSB0 --baud 921600 --csv data.csv
+"""
+
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+import serial
+
+TYPE_MEASUREMENT = 1
+HEADER = struct.Struct('<BIIBB')
+MAX_FRAME = 1100  # 255 values with COBS overhead
+
+
+def cobs_decode(data):
+    """Decode a COBS block without the zero delimiters, None if it is not valid COBS."""
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        if (code == 0) or (pos + code > len(data)):
+            return None
+        out += data[pos + 1:pos + code]
+        pos += code
+        if (code < 0xFF) and (pos < len(data)):
+            out.append(0)
+    return bytes(out)
+
+
+def parse_frame(chunk):
+    """Return (seq, time, columns, values) of a measurement frame, None if the chunk is not one."""
+    payload = cobs_decode(chunk)
+    if (payload is None) or (len(payload) < HEADER.size + 4):
+        return None
+    body, crc = payload[:-4], struct.unpack('<I', payload[-4:])[0]
+    if zlib.crc32(body) != crc:
+        return None
+    frame_type, seq, device_ms, columns, count = HEADER.unpack_from(body)
+    if (frame_type != TYPE_MEASUREMENT) or (len(body) != HEADER.size + 4 * count):
+        return None
+    values = struct.unpack_from('<%di' % count, body, HEADER.size)
+    return seq, device_ms, columns, values
+
+
+class Decoder:
+
+    def __init__(self, interval, csv_file):
+        self.interval = interval
+        self.csv_file = csv_file
+        self.last_seq = None
+        self.buffer = bytearray()
+        self.reset()
+        self.next_report = time.monotonic() + interval
+
+    def reset(self):
+        self.frames = 0
+        self.values = 0
+        self.gaps = 0
+        self.errors = 0
+        self.bytes = 0
+
+    def feed(self, data):
+        self.bytes += len(data)
+        self.buffer += data
+        # Everything up to the last zero is complete, frames or text
+        end = self.buffer.rfind(b'\x00')
+        if end < 0:
+            # Text only, print complete lines, but not the first part of a frame that may contain line feeds
+            if data and (len(self.buffer) < MAX_FRAME):
+                return
+            end = self.buffer.rfind(b'\n')
+            if end >= 0:
+                self.print_text(bytes(self.buffer[:end + 1]))
+                del self.buffer[:end + 1]
+            return
+        for chunk in bytes(self.buffer[:end]).split(b'\x00'):
+            self.handle_chunk(chunk)
+        del self.buffer[:end + 1]
+
+    def handle_chunk(self, chunk):
+        if not chunk:
+            return
+        frame = parse_frame(chunk)
+        if frame is None:
+            # Log text or a damaged frame
+            if all((b >= 0x20) or (b in b'\r\n\t\x1b') for b in chunk):
+                self.print_text(chunk)
+            else:
+                self.errors += 1
+            return
+        seq, device_ms, columns, values = frame
+        if (self.last_seq is not None) and (seq > self.last_seq + 1):
+            self.gaps += seq - self.last_seq - 1
+        self.last_seq = seq
+        self.frames += 1
+        self.values += len(values)
+        line = '%d;%d;%s\n' % (device_ms, seq, ','.join(str(v) for v in values))
+        if self.csv_file:
+            self.csv_file.write(line)
+        else:
+            sys.stdout.write(line)
+
+    def print_text(self, text):
+        sys.stdout.write(text.decode(errors='replace'))
+
+    def report(self):
+        if time.monotonic() < self.next_report:
+            return
+        self.next_report += self.interval
+        print('%7.1f frames/s  %9.0f values/s  %9.0f B/s  %5d lost  %5d bad' % (
+            self.frames / self.interval, self.values / self.interval, self.bytes / self.interval,
+            self.gaps, self.errors), file=sys.stderr)
+        self.reset()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decoder for the binary serial output of the sensor module.')
+    parser.add_argument('--port', required=True, help='serial port, for example /dev/ttyUSB0 or COM3')
+    parser.add_argument('--baud', type=int, default=115200, help='baud rate as selected on the sensor page')
+    parser.add_argument('--csv', help='write the values to this file instead of the console')
+    parser.add_argument('--interval', type=float, default=5, help='report interval in seconds')
+    args = parser.parse_args()
+
+    csv_file = open(args.csv, 'w') if args.csv else None
+    decoder = Decoder(args.interval, csv_file)
+    port = serial.Serial(args.port, args.baud, timeout=0.1)
+    try:
+        while True:
+            # An empty read after the timeout prints pending log text
+            decoder.feed(port.read(max(1, port.in_waiting)))
+            decoder.report()
+    except KeyboardInterrupt:
+        pass
+    port.close()
+    if csv_file:
+        csv_file.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+#
+# Copyright Production 3000
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Minimal syslog receiver for the UDP log output of MVP3000 devices.
+
+Prints every RFC 5424 message of the received datagrams, a batched datagram
+holds several messages separated by newline. Optionally answers the UDP
+auto-discovery as a server with the LOG skill, so devices without a configured
+syslog host send their log here.
+
+    python3 syslog_listener.py --port 5514 --discovery
+
+Enable syslog on the log section of the device main page and set the port to
+5514, ports below 1024 need root. Any other syslog server works as well, as
+long as batching is off on the device, which is the default.
+"""
+
+import argparse
+import re
+import select
+import socket
+import time
+
+SEVERITY = ['EMERG', 'ALERT', 'CRIT', 'ERROR', 'WARNING', 'NOTICE', 'INFO', 'DEBUG']
+
+# <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID [SD] MSG
+MESSAGE = re.compile(r'<(\d+)>1 (\S+) (\S+) (\S+) (\S+) (\S+) (-|\[.*?\]) ?(.*)')
+UPTIME = re.compile(r'sysUpTime="(\d+)"')
+SEQUENCE = re.compile(r'sequenceId="(\d+)"')
+
+
+def parse(line):
+    """Return (host, severity, uptime in s, sequence id, message) or None if not RFC 5424."""
+    match = MESSAGE.match(line)
+    if match is None:
+        return None
+    pri, _, host, _, _, _, data, message = match.groups()
+    uptime = UPTIME.search(data)
+    sequence = SEQUENCE.search(data)
+    return (host, SEVERITY[int(pri) % 8],
+            int(uptime.group(1)) / 100 if uptime else None,
+            int(sequence.group(1)) if sequence else None,
+            message)
+
+
+def format_uptime(seconds):
+    if seconds is None:
+        return '-'
+    days, seconds = divmod(int(seconds), 86400)
+    return '%dd %02d:%02d:%02d' % (days, seconds // 3600, seconds % 3600 // 60, seconds % 60)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Syslog receiver for MVP3000 devices.')
+    parser.add_argument('--port', type=int, default=5514, help='syslog port')
+    parser.add_argument('--discovery', action='store_true', help='answer the UDP auto-discovery with the LOG skill')
+    parser.add_argument('--discovery-port', type=int, default=4211, help='auto-discovery port of the devices')
+    args = parser.parse_args()
+
+    syslog = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    syslog.bind(('', args.port))
+    sockets = [syslog]
+
+    if args.discovery:
+        discovery = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        discovery.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        discovery.bind(('', args.discovery_port))
+        sockets.append(discovery)
+
+    print('Listening for syslog on UDP port %d%s' % (args.port, ', answering discovery' if args.discovery else ''))
+    datagrams = 0
+    messages = 0
+    try:
+        while True:
+            for sock in select.select(sockets, [], [])[0]:
+                data, address = sock.recvfrom(2048)
+                if sock is not syslog:
+                    # Devices broadcast MVP3000 and take the skills from the SERVER reply
+                    if data.startswith(b'MVP3000'):
+                        sock.sendto(b'SERVER LOG', address)
+                    continue
+
+                datagrams += 1
+                for line in data.decode(errors='replace').split('\n'):
+                    messages += 1
+                    parsed = parse(line)
+                    if parsed is None:
+                        print('%s %s' % (address[0], line))
+                        continue
+                    host, severity, uptime, sequence, message = parsed
+                    print('%s %s %s %-7s #%s %s' % (time.strftime('%H:%M:%S'), host, format_uptime(uptime), severity, sequence, message))
+    except KeyboardInterrupt:
+        pass
+    print('%d messages in %d datagrams' % (messages, datagrams))
+
+
+if __name__ == '__main__':
+    main()
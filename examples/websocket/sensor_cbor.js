@@ -0,0 +1,92 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Decoder for the CBOR encoded sensor data, covers the subset written by the device:
+// unsigned and negative integers, text strings, arrays and maps
+
+function decodeCbor(bytes) {
+    let view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+    let pos = 0;
+
+    function readLength(info) {
+        if (info < 24)
+            return info;
+        let value;
+        switch (info) {
+            case 24: value = view.getUint8(pos); pos += 1; break;
+            case 25: value = view.getUint16(pos); pos += 2; break;
+            case 26: value = view.getUint32(pos); pos += 4; break;
+            case 27: value = Number(view.getBigUint64(pos)); pos += 8; break;
+            default: throw new Error("Unsupported CBOR length " + info);
+        }
+        return value;
+    }
+
+    function readItem() {
+        let initial = view.getUint8(pos++);
+        let type = initial >> 5;
+        let value = readLength(initial & 0x1F);
+        switch (type) {
+            case 0: // Unsigned integer
+                return value;
+            case 1: // Negative integer
+                return -1 - value;
+            case 3: // Text string
+                let text = new TextDecoder().decode(bytes.subarray(pos, pos + value));
+                pos += value;
+                return text;
+            case 4: // Array
+                let array = new Array(value);
+                for (let i = 0; i < value; i++)
+                    array[i] = readItem();
+                return array;
+            case 5: // Map
+                let map = {};
+                for (let i = 0; i < value; i++) {
+                    let key = readItem();
+                    map[key] = readItem();
+                }
+                return map;
+            default:
+                throw new Error("Unsupported CBOR type " + type);
+        }
+    }
+
+    return readItem();
+}
+
+// Returns {seq, time, columns, values} with delta encoded values restored
+function decodeSensorData(bytes) {
+    let data = decodeCbor(bytes);
+    let values = data.v;
+    if (data.d) {
+        values = new Array(data.d.length);
+        let previous = 0;
+        for (let i = 0; i < data.d.length; i++) {
+            previous += data.d[i];
+            values[i] = previous;
+        }
+    }
+    return { seq: data.s, time: data.t, columns: data.c, values: values };
+}
+
+// Same format as the CSV output: time;values, rows separated by ;
+function sensorDataToCsv(data) {
+    let str = data.time + ";";
+    for (let i = 0; i < data.values.length; i++)
+        str += data.values[i] + (((i == data.values.length - 1) || ((i + 1) % data.columns == 0)) ? ";" : ",");
+    return str;
+}
@@ -34,6 +34,7 @@ function connect() {
     let websocketurl = "ws://" + deviceIp.trim() + wsfolder;
 
     websocket = new WebSocket(websocketurl);
+    websocket.binaryType = 'arraybuffer';
 
     websocket.onopen = function() {
         document.getElementById('coninfo').innerHTML = "Connected";
@@ -44,10 +45,16 @@ function connect() {
         console.log('Connection closed');
     }
     websocket.onmessage = function(e) {
+        let text = e.data;
+        // Sensor data is binary when CBOR encoding is selected on the device, see sensor_cbor.js
+        if (e.data instanceof ArrayBuffer) {
+            let data = decodeSensorData(new Uint8Array(e.data));
+            text = "#" + data.seq + " " + sensorDataToCsv(data);
+        }
         if (keepData)
-            document.getElementById('data').innerHTML = e.data + "\n" + document.getElementById('data').innerHTML;
+            document.getElementById('data').innerHTML = text + "\n" + document.getElementById('data').innerHTML;
         else
-            document.getElementById('data').innerHTML = e.data;
+            document.getElementById('data').innerHTML = text;
     }
     websocket.onerror = function() {
         document.getElementById('coninfo').innerHTML = "Error";
@@ -0,0 +1,105 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Minimal Arduino core for compiling the host-compilable library headers on a PC, only what the tests here need
+
+#ifndef MVP3000_TEST_ARDUINO
+#define MVP3000_TEST_ARDUINO
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <algorithm>
+
+typedef bool boolean;
+
+using std::min;
+using std::max;
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline uint32_t millis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+inline uint32_t micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline boolean isDigit(char c) { return (c >= '0') && (c <= '9'); }
+
+class __FlashStringHelper;
+#define F(x) ((const __FlashStringHelper*)(x))
+
+// Heap-backed like the Arduino String, so allocations show up in the counts of the tests
+class String {
+    public:
+        String(const char* text = "") { assign(text, strlen(text)); }
+        String(const __FlashStringHelper* text) : String((const char*)text) { }
+        String(const String& other) { assign(other.buffer, other.len); }
+        String(uint32_t value) { char digits[11]; assign(digits, snprintf(digits, sizeof(digits), "%lu", (unsigned long)value)); }
+        ~String() { delete[] buffer; }
+
+        String& operator=(const String& other) { if (this != &other) assign(other.buffer, other.len); return *this; }
+        String& operator+=(const String& other) { return append(other.buffer, other.len); }
+        String& operator+=(const char* text) { return append(text, strlen(text)); }
+        String& operator+=(uint32_t value) { return *this += String(value); }
+        friend String operator+(const String& a, const char* b) { String result(a); result += b; return result; }
+
+        boolean equals(const String& other) const { return (len == other.len) && (memcmp(buffer, other.buffer, len) == 0); }
+        const char* c_str() const { return buffer; }
+        unsigned int length() const { return len; }
+        char charAt(unsigned int i) const { return (i < len) ? buffer[i] : '\0'; }
+
+    private:
+        char* buffer = nullptr;
+        unsigned int len = 0;
+
+        void assign(const char* text, size_t textLen) {
+            char* old = buffer;
+            buffer = new char[textLen + 1];
+            memcpy(buffer, text, textLen);
+            buffer[textLen] = '\0';
+            len = textLen;
+            delete[] old;
+        }
+
+        String& append(const char* text, size_t textLen) {
+            char* old = buffer;
+            buffer = new char[len + textLen + 1];
+            memcpy(buffer, old, len);
+            memcpy(buffer + len, text, textLen);
+            len += textLen;
+            buffer[len] = '\0';
+            delete[] old;
+            return *this;
+        }
+};
+
+class EspClass {
+    public:
+        uint32_t getChipId() { return 0x3000; }
+        uint32_t getFreeHeap() { return 0; } // Adaptive lists do not grow
+        uint8_t getHeapFragmentation() { return 0; }
+};
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1 @@
+// Nothing of the MQTT library is used by the host-compilable headers, see Arduino.h
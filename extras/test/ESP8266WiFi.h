@@ -0,0 +1,62 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// WiFi client on a PC: bytes received are fed in by the test, bytes written are only counted
+
+#ifndef MVP3000_TEST_ESP8266WIFI
+#define MVP3000_TEST_ESP8266WIFI
+
+#include <Arduino.h>
+
+class WiFiClient {
+    public:
+        virtual ~WiFiClient() { }
+
+        size_t countWritten = 0;
+
+        // Bytes to be read next, not copied
+        void feed(const uint8_t* data, size_t length) {
+            feedData = data;
+            feedLength = length;
+            feedPos = 0;
+        }
+
+        virtual int read() {
+            uint8_t b;
+            return (read(&b, 1) == 1) ? b : -1;
+        }
+
+        virtual int read(uint8_t* buf, size_t size) {
+            size_t len = min(size, feedLength - feedPos);
+            memcpy(buf, feedData + feedPos, len);
+            feedPos += len;
+            return len;
+        }
+
+        size_t write(const uint8_t* buf, size_t size) {
+            countWritten += size;
+            return size;
+        }
+
+        int availableForWrite() { return 1460; }
+
+    private:
+        const uint8_t* feedData = nullptr;
+        size_t feedLength = 0;
+        size_t feedPos = 0;
+};
+
+#endif
@@ -0,0 +1,180 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Host benchmark of printf-style formatting into a String against the StringBuilder, with the heap allocations of each
+// The device version is examples/format_benchmark, the times here are only comparable with each other
+// Build and run from the library folder:
+// g++ -std=gnu++17 -O2 -DESP8266 -Iextras/test -Isrc extras/test/format_benchmark.cpp -o format_benchmark && ./format_benchmark
+
+#include <new>
+
+#include "_Helper.h"
+
+EspClass ESP;
+_Helper _helper;
+
+
+uint32_t countNew = 0;
+
+void* operator new(size_t size) {
+    countNew++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) {
+    countNew++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+
+const uint32_t ROUNDS = 200000;
+const uint8_t VALUE_COUNT = 100;
+
+int32_t data[VALUE_COUNT];
+float floats[VALUE_COUNT];
+
+uint8_t failures = 0;
+
+// Keeps the compiler from dropping the formatting
+volatile size_t sink = 0;
+
+struct Measurement {
+    uint32_t start_us;
+    uint32_t startNew;
+    Measurement() : start_us(micros()), startNew(countNew) { }
+    void report(const char* name, uint32_t count, const char* unit) {
+        uint32_t elapsed_us = micros() - start_us;
+        printf("%-28s %8.1f ns per %s, %5.2f allocations per %s\n", name, elapsed_us * 1000.0 / count, unit, (double)(countNew - startNew) / count, unit);
+    }
+};
+
+void check(boolean condition, const char* what) {
+    printf("%s %s\n", condition ? "PASS" : "FAIL", what);
+    if (!condition)
+        failures++;
+}
+
+// A typical web page row with time and numbers
+void benchmarkRow() {
+    Measurement printFormatted;
+    for (uint32_t i = 0; i < ROUNDS; i++) {
+        String row = _helper.printFormatted("<li>%s %d / %d</li> ", _helper.millisToTime(i * 1000ULL).c_str(), i, 40000 - i % 1000);
+        sink += row.length();
+    }
+    printFormatted.report("Row printFormatted", ROUNDS, "row");
+
+    Measurement builder;
+    for (uint32_t i = 0; i < ROUNDS; i++) {
+        StringBuffer<64> row;
+        row.append("<li>").appendTime(i * 1000ULL).append(' ').appendUint(i).append(" / ").appendUint(40000 - i % 1000).append("</li> ");
+        sink += row.length();
+    }
+    builder.report("Row StringBuilder", ROUNDS, "row");
+}
+
+// A sensor sample as CSV
+void benchmarkCsv() {
+    char buffer[12 * VALUE_COUNT + 1];
+
+    Measurement printf;
+    for (uint32_t i = 0; i < ROUNDS / 100; i++) {
+        size_t len = 0;
+        for (uint8_t j = 0; j < VALUE_COUNT; j++)
+            len += snprintf(buffer + len, sizeof(buffer) - len, "%ld%c", (long)data[j], (j == VALUE_COUNT - 1) ? ';' : ',');
+        sink += len;
+    }
+    printf.report("CSV snprintf", ROUNDS / 100, "line");
+
+    Measurement builder;
+    for (uint32_t i = 0; i < ROUNDS / 100; i++) {
+        StringBuilder csv(buffer, sizeof(buffer));
+        for (uint8_t j = 0; j < VALUE_COUNT; j++)
+            csv.appendInt(data[j]).append((j == VALUE_COUNT - 1) ? ';' : ',');
+        sink += csv.length();
+    }
+    builder.report("CSV StringBuilder", ROUNDS / 100, "line");
+}
+
+// Scaled sensor values with two decimals
+void benchmarkFloat() {
+    char buffer[24];
+
+    Measurement printf;
+    for (uint32_t i = 0; i < ROUNDS; i++)
+        sink += snprintf(buffer, sizeof(buffer), "%.2f", floats[i % VALUE_COUNT]);
+    printf.report("Float snprintf", ROUNDS, "value");
+
+    Measurement builder;
+    for (uint32_t i = 0; i < ROUNDS; i++) {
+        StringBuilder value(buffer, sizeof(buffer));
+        sink += value.appendFloat(floats[i % VALUE_COUNT], 2).length();
+    }
+    builder.report("Float StringBuilder", ROUNDS, "value");
+}
+
+// The fixed-point path of appendFloat() gives the same text as printf, the values out of its range go through printf
+void checkFloat() {
+    char expected[48];
+    char buffer[48];
+    boolean same = true;
+    for (uint8_t i = 0; i < VALUE_COUNT; i++) {
+        snprintf(expected, sizeof(expected), "%.2f", floats[i]);
+        StringBuilder value(buffer, sizeof(buffer));
+        value.appendFloat(floats[i], 2);
+        same &= (strcmp(expected, buffer) == 0);
+    }
+    check(same, "appendFloat() matches printf for sensor values");
+
+    // Around 2^24 after scaling, where a float stops holding every integer, and 2^31, one more than lroundf() can return
+    const float limits[] = { 167772.15f, -167772.15f, 167772.16f, -167772.16f, 21474836.48f, -21474836.48f, 2147483648.0f, -2147483648.0f, 1e20f, -1e20f };
+    same = true;
+    for (float limit : limits) {
+        snprintf(expected, sizeof(expected), "%.2f", limit);
+        StringBuilder value(buffer, sizeof(buffer));
+        value.appendFloat(limit, 2);
+        if (strcmp(expected, buffer) != 0) {
+            printf("     %s instead of %s\n", buffer, expected);
+            same = false;
+        }
+    }
+    check(same, "appendFloat() at the limits of the fixed-point range");
+}
+
+
+int main() {
+    srand(3000);
+    for (uint8_t i = 0; i < VALUE_COUNT; i++) {
+        data[i] = 10000 + rand() % 1000 + 100 * i;
+        floats[i] = (rand() % 2000000 - 1000000) / 100.0f;
+    }
+
+    benchmarkRow();
+    benchmarkCsv();
+    benchmarkFloat();
+    checkFloat();
+
+    printf("%s\n", (failures == 0) ? "All passed." : "FAILED");
+    return (failures == 0) ? 0 : 1;
+}
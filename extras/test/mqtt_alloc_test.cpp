@@ -0,0 +1,186 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Host test of the MQTT publish path: heap allocations per message once the buffers have grown, and matching of long control topics
+// Build and run from the library folder:
+// g++ -std=gnu++17 -O2 -DESP8266 -Iextras/test -Isrc extras/test/mqtt_alloc_test.cpp -o mqtt_alloc_test && ./mqtt_alloc_test
+
+#include <new>
+
+#include "_Helper_LinkedList.h"
+#include "NetMqtt_PublishQueue.h"
+#include "NetMqtt_TopicList.h"
+#include "NetMqtt_Qos.h"
+
+EspClass ESP;
+_Helper _helper;
+
+
+uint32_t countNew = 0;
+
+void* operator new(size_t size) {
+    countNew++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) {
+    countNew++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+
+uint8_t failures = 0;
+
+void check(boolean condition, const char* what) {
+    printf("%s %s\n", condition ? "PASS" : "FAIL", what);
+    if (!condition)
+        failures++;
+}
+
+// Publish through the queue and the in-flight window like NetMqtt::publishQueued() does, the broker acknowledges right away
+uint32_t publishMessages(MqttPublishQueue& queue, MqttInFlightWindow& inFlight, DataStructMqttTopic* topics, uint8_t topicCount, uint32_t count, boolean qos1) {
+    char message[200];
+    uint32_t before = countNew;
+    for (uint32_t i = 0; i < count; i++) {
+        // Lengths vary like sensor values do, the buffers grow to the longest one
+        size_t length = snprintf(message, sizeof(message), "%lu;%lu,%lu,%lu", (unsigned long)(i % 1000), (unsigned long)((i * 7) % 1000), (unsigned long)(i % 13), (unsigned long)((i * 31) % 1000));
+        queue.enqueue(&topics[i % topicCount], message, length);
+        while (queue.getSize() > 0) {
+            MqttMessageSlot* queued = queue.getOldest();
+            if (qos1) {
+                MqttInFlightSlot* sent = inFlight.append(queued);
+                queue.removeOldest();
+                inFlight.acknowledge(sent->packetId);
+            } else {
+                queue.removeSent();
+            }
+        }
+    }
+    return countNew - before;
+}
+
+// PUBLISH packet with QoS 1 as the broker sends it
+size_t buildPublish(uint8_t* packet, const char* topic, const char* payload, uint16_t packetId) {
+    size_t topicLen = strlen(topic);
+    size_t payloadLen = strlen(payload);
+    uint32_t remainingLen = 2 + topicLen + 2 + payloadLen;
+    size_t pos = 0;
+    packet[pos++] = 0x32;
+    do {
+        packet[pos] = remainingLen % 128;
+        remainingLen /= 128;
+        if (remainingLen > 0)
+            packet[pos] |= 0x80;
+        pos++;
+    } while (remainingLen > 0);
+    packet[pos++] = topicLen >> 8;
+    packet[pos++] = topicLen & 0xFF;
+    memcpy(packet + pos, topic, topicLen);
+    pos += topicLen;
+    packet[pos++] = packetId >> 8;
+    packet[pos++] = packetId & 0xFF;
+    memcpy(packet + pos, payload, payloadLen);
+    return pos + payloadLen;
+}
+
+void receive(MqttWiFiClient& client, const uint8_t* packet, size_t length) {
+    client.feed(packet, length);
+    // The MQTT library reads the header byte by byte and the rest in blocks
+    client.read();
+    client.read();
+    if (length > 256)
+        client.read();
+    uint8_t buf[64];
+    while (client.read(buf, sizeof(buf)) > 0) { }
+}
+
+
+int main() {
+    const uint32_t MESSAGES = 100000;
+
+    DataStructMqttTopic topics[3] = {
+        DataStructMqttTopic("sensor", nullptr, nullptr),
+        DataStructMqttTopic("log", nullptr, nullptr),
+        DataStructMqttTopic("a_module_with_a_rather_long_base_topic_name_to_test_the_topic_buffer", nullptr, nullptr)
+    };
+
+    for (uint8_t policy : { MqttPublishQueue::DropPolicy::OLDEST, MqttPublishQueue::DropPolicy::COALESCE }) {
+        MqttPublishQueue queue;
+        MqttInFlightWindow inFlight;
+        queue.setMaxSize(8);
+        queue.dropPolicy = policy;
+        queue.accepting = true;
+        inFlight.setWindow(16);
+
+        // The first messages grow the buffers
+        publishMessages(queue, inFlight, topics, 3, 1000, true);
+        uint32_t allocQos0 = publishMessages(queue, inFlight, topics, 3, MESSAGES, false);
+        uint32_t allocQos1 = publishMessages(queue, inFlight, topics, 3, MESSAGES, true);
+        printf("Drop policy %d: %lu allocations for %lu messages QoS 0, %lu for QoS 1\n", policy, (unsigned long)allocQos0, (unsigned long)MESSAGES, (unsigned long)allocQos1);
+        check(allocQos0 == 0, "No allocation per QoS 0 message");
+        check(allocQos1 == 0, "No allocation per QoS 1 message");
+    }
+
+    // Queue full, the oldest message is overwritten
+    {
+        MqttPublishQueue queue;
+        queue.setMaxSize(4);
+        queue.accepting = true;
+        for (uint8_t i = 0; i < 8; i++)
+            queue.enqueue(&topics[0], "123456", 6);
+        uint32_t before = countNew;
+        for (uint32_t i = 0; i < MESSAGES; i++)
+            queue.enqueue(&topics[i % 3], "123456", 6);
+        check((countNew - before == 0) && (queue.getSize() == 4), "No allocation when dropping the oldest message");
+    }
+
+    // Control topics are compared in full, the receive buffer is sized to the longest one
+    {
+        MqttWiFiClient client;
+        uint8_t packet[512];
+        const String& longTopic = topics[2].getCtrlTopic();
+        client.reserveTopic(topics[0].getCtrlTopic().length());
+        client.reserveTopic(longTopic.length());
+
+        receive(client, packet, buildPublish(packet, longTopic.c_str(), "INFO", 0x1234));
+        check(!client.isTopicTruncated() && (strcmp(client.getLastPublishTopic(), longTopic.c_str()) == 0), "Long control topic received in full");
+        check(client.lastPublishPacketId == 0x1234, "Packet id after a long topic");
+
+        String longerTopic = longTopic + "_and_more";
+        receive(client, packet, buildPublish(packet, longerTopic.c_str(), "INFO", 0x1235));
+        check(client.isTopicTruncated(), "Longer topic than subscribed is marked as cut");
+
+        receive(client, packet, buildPublish(packet, topics[0].getCtrlTopic().c_str(), "INFO", 0x1236));
+        check(!client.isTopicTruncated() && (strcmp(client.getLastPublishTopic(), topics[0].getCtrlTopic().c_str()) == 0), "Short topic after a cut one");
+
+        uint32_t before = countNew;
+        for (uint32_t i = 0; i < 1000; i++)
+            receive(client, packet, buildPublish(packet, longTopic.c_str(), "INFO", i));
+        check(countNew - before == 0, "No allocation per received message");
+    }
+
+    printf("%s\n", (failures == 0) ? "All passed." : "FAILED");
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+#
+# Copyright Production 3000
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Gzip the static web assets and write them as PROGMEM arrays to src/NetWeb_Assets.h.
+
+The Arduino build has no pre-build step, so the generated header is committed.
+Run this script after changing any of the assets in this folder:
+
+    python3 extras/web/gzip_assets.py
+
+The output is reproducible: the gzip header carries no timestamp and the ETag is
+a hash of the uncompressed content.
+"""
+
+import gzip
+import hashlib
+import os
+
+ASSETS = [
+    # (file, uri, content type)
+    ('mvp3000.css', '/mvp3000.css', 'text/css'),
+    ('mvp3000.js', '/mvp3000.js', 'application/javascript'),
+]
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+OUTPUT = os.path.join(HERE, '..', '..', 'src', 'NetWeb_Assets.h')
+
+LICENSE = '''/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+'''
+
+
+def identifier(name):
+    return 'webAsset_' + ''.join(c if c.isalnum() else '_' for c in name)
+
+
+def byte_lines(data, per_line=16):
+    return [', '.join('0x%02x' % b for b in data[i:i + per_line]) for i in range(0, len(data), per_line)]
+
+
+def main():
+    out = [LICENSE]
+    out.append('// Generated by extras/web/gzip_assets.py, do not edit\n')
+    out.append('#ifndef MVP3000_NETWEB_ASSETS')
+    out.append('#define MVP3000_NETWEB_ASSETS\n')
+    out.append('#include <Arduino.h>\n\n')
+
+    entries = []
+    for name, uri, content_type in ASSETS:
+        with open(os.path.join(HERE, name), 'rb') as f:
+            content = f.read()
+        compressed = gzip.compress(content, compresslevel=9, mtime=0)
+        etag = '"%s"' % hashlib.sha256(content).hexdigest()[:16]
+        var = identifier(name)
+        out.append('// %s: %d bytes, %d bytes gzipped' % (name, len(content), len(compressed)))
+        out.append('const uint8_t %s[] PROGMEM = {' % var)
+        out.extend('    %s,' % line for line in byte_lines(compressed))
+        out.append('};\n')
+        entries.append('    { "%s", "%s", "\\"%s\\"", %s, sizeof(%s) },' % (uri, content_type, etag.strip('"'), var, var))
+
+    out.append('''/**
+ * @brief Static asset stored gzipped in flash, served with an ETag for revalidation.
+ */
+struct WebAsset {
+    const char* uri;
+    const char* contentType;
+    const char* etag; // Quoted, as sent in the header
+    const uint8_t* data;
+    size_t length;
+};
+''')
+    out.append('const WebAsset webAssets[] = {')
+    out.extend(entries)
+    out.append('};')
+    out.append('const uint8_t webAssetCount = sizeof(webAssets) / sizeof(WebAsset);\n')
+    out.append('#endif')
+
+    with open(OUTPUT, 'w') as f:
+        f.write('\n'.join(out) + '\n')
+    print('Wrote %s' % os.path.normpath(OUTPUT))
+
+
+if __name__ == '__main__':
+    main()
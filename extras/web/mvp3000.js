@@ -0,0 +1,4 @@
+function promptId(f) {
+    f.elements['deviceId'].value = prompt('WARNING! Confirm with device ID.');
+    return (f.elements['deviceId'].value == '') ? false : true;
+}
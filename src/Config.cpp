@@ -21,6 +21,12 @@ extern MVP3000 mvp;
 
 
 void Config::setup() {
+    mountFileSystem();
+    if (fileSystemOK && (format == Format::BINARY_BUNDLE))
+        loadBundle();
+}
+
+void Config::mountFileSystem() {
     // On ESP32 this can be called with setup(true) to format the FS automatically
     // Contrary to documentation, it (I think) defaults to not do this automatically
     if (SPIFFS.begin()) {
@@ -29,9 +35,9 @@ void Config::setup() {
     }
 
     // Code should only be executed for factory-new ESP, otherwise device likely broken beyond repair
-    mvp.logger.write(CfgLogger::Level::WARNING, "Failed to mount file system. Formatting ...");
+    MVP3000_LOG(CONFIG, WARNING, "Failed to mount file system. Formatting ...");
     if (!SPIFFS.format()) {
-        mvp.logger.write(CfgLogger::Level::ERROR, "Formatting file system failed.");
+        MVP3000_LOG(CONFIG, ERROR, "Formatting file system failed.");
         SPIFFS.end();
         return;
     }
@@ -43,10 +49,14 @@ void Config::setup() {
     }
 
     SPIFFS.end();
-    mvp.logger.write(CfgLogger::Level::ERROR, "Permanently failed to mount file system.");
+    MVP3000_LOG(CONFIG, ERROR, "Permanently failed to mount file system.");
 }
 
 void Config::loop() {
+    // Write one pending configuration per loop once the changes settled, the flash write stalls the loop
+    if ((dirtyCount > 0) && ((millis() - lastDirty_ms > quietPeriod_ms) || (millis() - firstDirty_ms > maxDelay_ms)))
+        writeNextDirty();
+
     // Check if delayed factory reset was started
     if (delayedFactoryReset_ms > 0) {
         if (millis() > delayedFactoryReset_ms) {
@@ -62,40 +72,154 @@ bool Config::isReadyFS() {
     if (fileSystemOK)
         return true;
 
-    mvp.logger.write(CfgLogger::Level::ERROR, "Permanent file system error.");
+    MVP3000_LOG(CONFIG, ERROR, "Permanent file system error.");
     return false;
 }
 
 void Config::readCfg(JsonInterface &cfg) {
+    uint32_t start_us = micros();
+    addCfg(&cfg);
+    if (!readCfgFromBundle(cfg))
+        readCfgFromJson(cfg);
+    loadTime_us += micros() - start_us;
+}
+
+bool Config::readCfgFromBundle(JsonInterface &cfg) {
+    if (bundle == nullptr)
+        return false;
+    // Find the section of the configuration, the bundle starts with the header
+    uint32_t hash = _helper.hashStringDjb2(cfg.cfgName.c_str());
+    TlvReader bundleReader(bundle + sizeof(bundleHeader), bundleLength - sizeof(bundleHeader));
+    while (bundleReader.next()) {
+        if ((bundleReader.key != hash) || (bundleReader.type != TLV_SECTION))
+            continue;
+        TlvReader sectionReader = bundleReader.section();
+        if (!cfg.importFromBinary(sectionReader)) {
+            // Content mismatch, replace the section
+            MVP3000_LOGF(CONFIG, ERROR, "Mismatch between bundle and expected content, rewriting: %s", cfg.cfgName.c_str());
+            writeCfg(cfg);
+        }
+        return true;
+    }
+    return false;
+}
+
+void Config::readCfgFromJson(JsonInterface &cfg) {
+    // With the bundle only configurations stored before have a file, do not warn about the others
+    if ((format == Format::BINARY_BUNDLE) && (!fileSystemOK || !SPIFFS.exists(fileNameCompletor(cfg.cfgName.c_str()))))
+        return;
     if (!readFileToJson(cfg.cfgName.c_str()))
         return;
     // Import settings from JSON
     if (!cfg.importFromJson(jsonDoc)) {
         // JSON vs. content mismatch, remove file
         removeFile(cfg.cfgName.c_str());
-        mvp.logger.writeFormatted(CfgLogger::Level::ERROR, "Mismatch between loaded JSON and expected content, deleting: %s", cfg.cfgName.c_str());
+        MVP3000_LOGF(CONFIG, ERROR, "Mismatch between loaded JSON and expected content, deleting: %s", cfg.cfgName.c_str());
     } else {
-        mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Config loaded: %s", cfg.cfgName.c_str());
+        MVP3000_LOGF(CONFIG, INFO, "Config loaded: %s", cfg.cfgName.c_str());
+        // Move to the bundle
+        if (format == Format::BINARY_BUNDLE) {
+            jsonFilesLeft = true;
+            writeCfg(cfg);
+        }
     }
     // Cleanup for next
     jsonDoc.clear();
 }
 
+void Config::finishLoading() {
+    MVP3000_LOGF(CONFIG, INFO, "Configs loaded in %lu us.", (unsigned long)loadTime_us);
+    freeBundle();
+}
+
+void Config::addCfg(JsonInterface* cfg) {
+    for (uint8_t i = 0; i < cfgCount; i++) {
+        if (cfgs[i] == cfg)
+            return;
+    }
+    if (cfgCount >= MAX_CFGS) {
+        MVP3000_LOGF(CONFIG, ERROR, "Too many configs, not stored: %s", cfg->cfgName.c_str());
+        return;
+    }
+    cfgs[cfgCount++] = cfg;
+}
+
 void Config::writeCfg(JsonInterface &cfg) {
+    // Web requests mark configurations from their own task
+    lockCfgs();
+    addCfg(&cfg);
+    lastDirty_ms = millis();
+    for (uint8_t i = 0; i < dirtyCount; i++) {
+        if (dirtyCfgs[i] == &cfg) {
+            unlockCfgs();
+            return;
+        }
+    }
+    // Should not happen with the few configs there are, make room by writing the oldest
+    if ((dirtyCount >= MAX_DIRTY) && !writeNextDirty()) {
+        MVP3000_LOGF(CONFIG, ERROR, "Too many pending configs, not written: %s", cfg.cfgName.c_str());
+        unlockCfgs();
+        return;
+    }
+    if (dirtyCount == 0)
+        firstDirty_ms = lastDirty_ms;
+    dirtyCfgs[dirtyCount++] = &cfg;
+    unlockCfgs();
+}
+
+void Config::flush() {
+    // Stop at the first failure, a broken file system must not hang a restart
+    while ((dirtyCount > 0) && writeNextDirty())
+        ;
+}
+
+bool Config::writeNextDirty() {
+    lockCfgs();
+    boolean written;
+    if (format == Format::BINARY_BUNDLE) {
+        // All configurations are in one file, written at once
+        written = writeBundle();
+        if (written)
+            dirtyCount = 0;
+    } else {
+        written = writeCfgNow(*dirtyCfgs[0]);
+        if (written) {
+            dirtyCount--;
+            for (uint8_t i = 0; i < dirtyCount; i++)
+                dirtyCfgs[i] = dirtyCfgs[i + 1];
+        }
+    }
+    // Keep pending and try again after the quiet period
+    if (!written)
+        firstDirty_ms = lastDirty_ms = millis();
+    unlockCfgs();
+    return written;
+}
+
+bool Config::writeCfgNow(JsonInterface &cfg) {
     if (!jsonDoc.isNull()) {
-        mvp.logger.write(CfgLogger::Level::WARNING, "JSON doc was not empty.");
+        MVP3000_LOG(CONFIG, WARNING, "JSON doc was not empty.");
         jsonDoc.clear();
     }
     // Export settings to JSON
     cfg.exportToJson(jsonDoc);
     // Write to file
-    writeJsonToFile(cfg.cfgName.c_str());
+    return writeJsonToFile(cfg.cfgName.c_str());
 }
 
+#ifdef ESP32
+void Config::lockCfgs() { xSemaphoreTakeRecursive(cfgMutex, portMAX_DELAY); }
+void Config::unlockCfgs() { xSemaphoreGiveRecursive(cfgMutex); }
+#else
+// Web requests run between loop iterations, never at the same time
+void Config::lockCfgs() { }
+void Config::unlockCfgs() { }
+#endif
+
 bool Config::readFileToJson(const char* fileName) {
     // Check if all other operations are done (this is mainly useful while coding)
     if (!jsonDoc.isNull()) {
-        mvp.logger.write(CfgLogger::Level::WARNING, "JSON doc was not empty.");
+        MVP3000_LOG(CONFIG, WARNING, "JSON doc was not empty.");
         jsonDoc.clear();
     }
 
@@ -109,16 +233,16 @@ bool Config::readFileToJson(const char* fileName) {
                 case DeserializationError::EmptyInput:
                 case DeserializationError::IncompleteInput:
                 case DeserializationError::InvalidInput:
-                    mvp.logger.writeFormatted(CfgLogger::Level::ERROR, "Config JSON is invalid: %s", fileName);
+                    MVP3000_LOGF(CONFIG, ERROR, "Config JSON is invalid: %s", fileName);
                     return false;
                 case DeserializationError::NoMemory:
-                    mvp.logger.writeFormatted(CfgLogger::Level::ERROR, "Config JSON Not enough memory: %s", fileName);
+                    MVP3000_LOGF(CONFIG, ERROR, "Config JSON Not enough memory: %s", fileName);
                     return false;
                 case DeserializationError::TooDeep:
-                    mvp.logger.writeFormatted(CfgLogger::Level::ERROR, "Config JSON too deep: %s", fileName);
+                    MVP3000_LOGF(CONFIG, ERROR, "Config JSON too deep: %s", fileName);
                     return false;
                 default:
-                    mvp.logger.writeFormatted(CfgLogger::Level::ERROR, "Config JSON deserialization failed: %s", fileName);
+                    MVP3000_LOGF(CONFIG, ERROR, "Config JSON deserialization failed: %s", fileName);
                     return false;
             }
 
@@ -126,21 +250,85 @@ bool Config::readFileToJson(const char* fileName) {
     });
 }
 
-void Config::writeJsonToFile(const char* fileName) {
+bool Config::writeJsonToFile(const char* fileName) {
     // Empty cfg, remove file if any
     if (jsonDoc.isNull()) {
         removeFile(fileName);
-        mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "Empty cfg, cancel saving: %s", fileName);
-        return;
+        MVP3000_LOGF(CONFIG, WARNING, "Empty cfg, cancel saving: %s", fileName);
+        return true;
     }
 
-    writeFile(fileName, [&](File& jsonFile) -> bool {
+    boolean written = writeFile(fileName, [&](File& jsonFile) -> bool {
         return serializeJson(jsonDoc, jsonFile) != 0;
     });
-    mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Config written: %s", fileName);
+    if (written)
+        MVP3000_LOGF(CONFIG, INFO, "Config written: %s", fileName);
 
     // Clean up for next
     jsonDoc.clear();
+    return written;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Config::loadBundle() {
+    uint32_t start_us = micros();
+    readFile(bundleName, [&](File& file) -> bool {
+        bundleLength = file.size();
+        bundle = new uint8_t[bundleLength];
+        if ((bundleLength < sizeof(bundleHeader)) || (file.read(bundle, bundleLength) != bundleLength) || (memcmp(bundle, bundleHeader, sizeof(bundleHeader)) != 0)) {
+            MVP3000_LOG(CONFIG, ERROR, "Config bundle is invalid.");
+            freeBundle();
+            return false;
+        }
+        return true;
+    }, ".bin");
+    loadTime_us += micros() - start_us;
+}
+
+void Config::freeBundle() {
+    delete[] bundle;
+    bundle = nullptr;
+    bundleLength = 0;
+}
+
+bool Config::writeBundle() {
+    // The size is not known in advance, grow the buffer until all configurations fit
+    size_t capacity = 512;
+    uint8_t* buffer;
+    size_t length;
+    while (true) {
+        buffer = new uint8_t[capacity];
+        TlvWriter tlv(buffer, capacity);
+        for (uint8_t i = 0; i < cfgCount; i++) {
+            tlv.beginSection(_helper.hashStringDjb2(cfgs[i]->cfgName.c_str()));
+            cfgs[i]->exportToBinary(tlv);
+            tlv.endSection();
+        }
+        if (!tlv.overflow) {
+            length = tlv.length;
+            break;
+        }
+        delete[] buffer;
+        capacity *= 2;
+    }
+
+    boolean written = writeFile(bundleName, [&](File& file) -> bool {
+        return (file.write(bundleHeader, sizeof(bundleHeader)) == sizeof(bundleHeader)) && (file.write(buffer, length) == length);
+    }, ".bin");
+    delete[] buffer;
+    if (!written)
+        return false;
+    MVP3000_LOGF(CONFIG, INFO, "Config bundle written: %d configs, %d bytes", cfgCount, (int)(length + sizeof(bundleHeader)));
+
+    // Configurations read from JSON files are in the bundle now
+    if (jsonFilesLeft) {
+        for (uint8_t i = 0; i < cfgCount; i++)
+            removeFile(cfgs[i]->cfgName.c_str());
+        jsonFilesLeft = false;
+    }
+    return true;
 }
 
 
@@ -157,7 +345,14 @@ void Config::factoryResetDevice(boolean keepWifi) {
     if (!isReadyFS())
         return;
 
-    mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "Starting factory reset ...");
+    MVP3000_LOGF(CONFIG, WARNING, "Starting factory reset ...");
+
+    // Pending configs would be written to the formatted file system, only configs written after the reset are kept
+    lockCfgs();
+    dirtyCount = 0;
+    cfgCount = 0;
+    unlockCfgs();
+    freeBundle();
 
     // Clear any saved data, factory config will be restored to defaults on reboot
     // Triggers watchdog _a_lot_, but does not cause reboot
@@ -179,38 +374,46 @@ void Config::removeFile(const char* fileName) {
         return;
 
     SPIFFS.remove(fileNameCompletor(fileName));
+    SPIFFS.remove(fileNameCompletor(fileName, ".tmp"));
 }
 
-String Config::fileNameCompletor(const char* fileName) {
+String Config::fileNameCompletor(const char* fileName, const char* extension) {
     // Remove leading '/', there should be none
     if (fileName[0] == '/')
         fileName = fileName + 1;
     // Add leading '/' and ending .json
-    return "/" + String(fileName) + ".json";
+    return "/" + String(fileName) + extension;
 }
 
-bool Config::readFile(const char* fileName, std::function<bool(File& file)> readerFunc) {
+bool Config::readFile(const char* fileName, std::function<bool(File& file)> readerFunc, const char* extension) {
     if (!fileSystemOK)
         return false;
 
-    String pathFileName = fileNameCompletor(fileName);
+    String pathFileName = fileNameCompletor(fileName, extension);
+
+    // A complete temp file without the file itself is left if the power was lost while replacing the file
+    String tempFileName = fileNameCompletor(fileName, ".tmp");
+    if (!SPIFFS.exists(pathFileName) && SPIFFS.exists(tempFileName)) {
+        SPIFFS.rename(tempFileName, pathFileName);
+        MVP3000_LOGF(CONFIG, WARNING, "File restored from interrupted write: %s", pathFileName.c_str());
+    }
 
     File file = SPIFFS.open(pathFileName, "r");
     // It's no longer enough to check if open returned true. Also need to check that it is not a folder. The documentations needs to be updated. ;)
     if (!file || file.isDirectory()) {
-        mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "File not found for reading: %s", pathFileName.c_str());
+        MVP3000_LOGF(CONFIG, WARNING, "File not found for reading: %s", pathFileName.c_str());
         return false;
     }
 
     // Empty file, remove. This should never happen I think.
     if (file.size() == 0) {
         SPIFFS.remove(pathFileName);
-        mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "File empty, removed: %s", pathFileName.c_str());
+        MVP3000_LOGF(CONFIG, WARNING, "File empty, removed: %s", pathFileName.c_str());
         return false;
     }
 
     // Load good
-    mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Content read from file: %s", pathFileName.c_str());
+    MVP3000_LOGF(CONFIG, INFO, "Content read from file: %s", pathFileName.c_str());
 
     // Execute the read function, specific to content type: json or custom
     boolean result = readerFunc(file);
@@ -219,28 +422,41 @@ bool Config::readFile(const char* fileName, std::function<bool(File& file)> read
     return result;
 }
 
-bool Config::writeFile(const char* fileName, std::function<bool(File& file)> writerFunc) {
+bool Config::writeFile(const char* fileName, std::function<bool(File& file)> writerFunc, const char* extension) {
     if (!fileSystemOK)
         return false;
 
-    String pathFileName = fileNameCompletor(fileName);
+    String pathFileName = fileNameCompletor(fileName, extension);
+    // Written to a temp file first, the previous file stays intact if writing fails or the power is lost
+    String tempFileName = fileNameCompletor(fileName, ".tmp");
 
     // Open file, automatically created if not existing
-    File file = SPIFFS.open(pathFileName, "w");
+    File file = SPIFFS.open(tempFileName, "w");
     // It's no longer enough to check if open returned true. Also need to check that it is not a folder. The documentations needs to be updated. ;)
     if (!file || file.isDirectory()) {
-        mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "Failed to open file for writing: %s", pathFileName.c_str());
+        MVP3000_LOGF(CONFIG, WARNING, "Failed to open file for writing: %s", tempFileName.c_str());
         return false;
     }
 
     // Execute the write function, specific to content type
     if (!writerFunc(file)) {
-        mvp.logger.writeFormatted(CfgLogger::Level::ERROR, "Failed to write to file: %s", pathFileName.c_str());
+        MVP3000_LOGF(CONFIG, ERROR, "Failed to write to file: %s", pathFileName.c_str());
         file.close();
+        SPIFFS.remove(tempFileName);
         return false;
     }
-
-    mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Content written to file: %s", pathFileName.c_str());
+    size_t size = file.size();
     file.close();
+
+    // SPIFFS does not rename onto an existing file
+    SPIFFS.remove(pathFileName);
+    if (!SPIFFS.rename(tempFileName, pathFileName)) {
+        MVP3000_LOGF(CONFIG, ERROR, "Failed to replace file: %s", pathFileName.c_str());
+        return false;
+    }
+
+    countWrites++;
+    countBytesWritten += size;
+    MVP3000_LOGF(CONFIG, INFO, "Content written to file: %s", pathFileName.c_str());
     return true;
 }
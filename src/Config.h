@@ -40,9 +40,53 @@ class Config {
         void setup();
         void loop();
 
+        // All configurations in one binary file read once at boot, or one JSON file per configuration
+        enum Format: uint8_t {
+            JSON_FILES = 0,
+            BINARY_BUNDLE = 1
+        };
+        uint8_t format = Format::BINARY_BUNDLE;
+
+        /**
+         * @brief Read a configuration from the bundle, or from its JSON file if it is not in the bundle yet.
+         *
+         * @param cfg The configuration, needs to stay valid.
+         */
         void readCfg(JsonInterface &cfg);
+
+        /**
+         * @brief Free the bundle read at boot and report the time spent loading the configurations.
+         */
+        void finishLoading();
+        uint32_t loadTime_us = 0;
+
+        /**
+         * @brief Mark a configuration to be written to flash.
+         *
+         * The write is deferred until no configuration changed for a quiet period, a burst of changes is written once.
+         * The values are exported when the configuration is written.
+         *
+         * @param cfg The configuration, needs to stay valid.
+         */
         void writeCfg(JsonInterface &cfg);
 
+        /**
+         * @brief Write all pending configurations now, for example before a restart.
+         */
+        void flush();
+
+        /**
+         * @brief Hold while changing settings outside of the loop, for example from a web request.
+         *
+         * Pending configurations are exported and written while holding it, a write never sees a half-changed setting and no mark is lost.
+         */
+        void lockCfgs();
+        void unlockCfgs();
+
+        uint32_t countWrites = 0; // Configurations written to flash since boot
+        uint32_t countBytesWritten = 0;
+        uint8_t getPendingCount() const { return dirtyCount; }
+
         void factoryResetDevice(boolean keepWifi = false);
         uint32_t delayedFactoryReset_ms = 0;
         boolean delayedFactoryResetKeepWifi = true;
@@ -51,16 +95,53 @@ class Config {
     private:
         JsonDocument jsonDoc;
 
+        // Write-behind, configurations waiting to be written
+        static const uint8_t MAX_DIRTY = 8;
+        JsonInterface* dirtyCfgs[MAX_DIRTY];
+        uint8_t dirtyCount = 0;
+        uint32_t firstDirty_ms = 0;
+        uint32_t lastDirty_ms = 0;
+        uint16_t quietPeriod_ms = 2000; // Since the last change
+        uint16_t maxDelay_ms = 10000; // Since the first change, for continuous changes
+
+        // A configuration stays pending until it was written successfully
+        bool writeNextDirty();
+        bool writeCfgNow(JsonInterface &cfg);
+
+#ifdef ESP32
+        SemaphoreHandle_t cfgMutex = xSemaphoreCreateRecursiveMutex(); // Recursive, saving a setting marks the configuration while holding it
+#endif
+
+        // Configurations read or written, all are stored in the bundle
+        static const uint8_t MAX_CFGS = 16;
+        JsonInterface* cfgs[MAX_CFGS];
+        uint8_t cfgCount = 0;
+        void addCfg(JsonInterface* cfg);
+
+        // Bundle, kept in memory during boot only
+        const char* bundleName = "cfgBundle";
+        const uint8_t bundleHeader[5] = { 'M', 'V', 'P', 'C', 1 }; // Magic and version
+        uint8_t* bundle = nullptr;
+        size_t bundleLength = 0;
+        boolean jsonFilesLeft = false; // Configurations were read from JSON files, remove them once the bundle is written
+
+        void loadBundle();
+        void freeBundle();
+        bool readCfgFromBundle(JsonInterface &cfg);
+        void readCfgFromJson(JsonInterface &cfg);
+        bool writeBundle();
+
         boolean fileSystemOK = false;
         bool isReadyFS();
+        void mountFileSystem();
 
         bool readFileToJson(const char* fileName);
-        void writeJsonToFile(const char* fileName);
+        bool writeJsonToFile(const char* fileName);
 
-        bool readFile(const char* filename, std::function<bool(File& file)> writerFunc);
-        bool writeFile(const char* filename, std::function<bool(File& file)> writerFunc);
+        bool readFile(const char* filename, std::function<bool(File& file)> writerFunc, const char* extension = ".json");
+        bool writeFile(const char* filename, std::function<bool(File& file)> writerFunc, const char* extension = ".json");
         void removeFile(const char* fileName);
-        String fileNameCompletor(const char* fileName);
+        String fileNameCompletor(const char* fileName, const char* extension = ".json");
 };
 
 #endif
\ No newline at end of file
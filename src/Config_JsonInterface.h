@@ -23,6 +23,9 @@ limitations under the License.
 #include "_Helper.h"
 extern _Helper _helper;
 
+#include "_Helper_JsonWriter.h"
+#include "Config_Tlv.h"
+
 
 /**
  * @brief General interface for exporting and importing configuration data to/from JSON.
@@ -50,6 +53,38 @@ struct JsonInterface {
      */
     virtual bool importFromJson(JsonDocument &jsonDoc) { return true; };
 
+    /**
+     * @brief Export the configuration data as binary records, used for the config bundle.
+     *
+     * Without an override the JSON export is stored as text in a single record, so configurations of custom modules that only implement the JSON methods are kept.
+     *
+     * @param tlv The writer to write the records to.
+     */
+    virtual void exportToBinary(TlvWriter &tlv) {
+        JsonDocument jsonDoc;
+        exportToJson(jsonDoc);
+        String json;
+        serializeJson(jsonDoc, json);
+        tlv.writeString(_helper.hashStringDjb2("json"), json);
+    };
+
+    /**
+     * @brief Import the configuration data from binary records.
+     *
+     * Without an override the single JSON record written by the default export is parsed and passed to the JSON import.
+     *
+     * @param tlv The reader of the records of this configuration.
+     * @return True if the import was successful, false otherwise.
+     */
+    virtual bool importFromBinary(TlvReader &tlv) {
+        if (!tlv.next() || (tlv.type != TLV_STRING))
+            return false;
+        JsonDocument jsonDoc;
+        if (deserializeJson(jsonDoc, (const char*)tlv.value, tlv.valueLength))
+            return false;
+        return importFromJson(jsonDoc);
+    };
+
     JsonInterface(const String& cfgName) : cfgName(cfgName) { };
 
 };
@@ -87,6 +122,8 @@ struct CfgJsonInterface : public JsonInterface {
     // Main setting structure, minimalistic linked list
     struct SettingNode {
         uint32_t hash; // Hash of the key
+        String key; // Plain key for the JSON API
+        boolean secret = false; // Value is not readable via the JSON API
 
         uint8_t type; // 0 = boolean, 1 = int, 2 = String
         union { // Pointer to the type-specific setting core
@@ -114,6 +151,49 @@ struct CfgJsonInterface : public JsonInterface {
         SettingNode(uint32_t _hash, String *_value, std::function<bool(const String&)> checkValue) : hash(_hash), type(2) {
             settingCore.s = new SettingCore<String>(_value, checkValue);
         };
+
+        /**
+         * @brief Check a value from a web request without setting it.
+         *
+         * @param value The new value as string, booleans as 0/1.
+         * @return True if the value is valid for the setting.
+         */
+        bool checkString(const String& value) {
+            switch (type) {
+                case 0: // boolean
+                    return settingCore.b->checkValue(value.toInt() != 0);
+                case 1: // uint16_t, reject text and values that would wrap around
+                    if (!_helper.isValidInteger(value) || (value.toInt() < 0) || (value.toInt() > std::numeric_limits<uint16_t>::max()))
+                        return false;
+                    return settingCore.i->checkValue(value.toInt());
+                case 2: // String
+                    return settingCore.s->checkValue(value);
+            }
+            return false;
+        }
+
+        /**
+         * @brief Check and set a value from a web request.
+         *
+         * @param value The new value as string, booleans as 0/1.
+         * @return True if the value was set.
+         */
+        bool setString(const String& value) {
+            if (!checkString(value))
+                return false;
+            switch (type) {
+                case 0: // boolean
+                    *settingCore.b->value = (value.toInt() != 0);
+                    break;
+                case 1: // uint16_t
+                    *settingCore.i->value = value.toInt();
+                    break;
+                case 2: // String
+                    *settingCore.s->value = value;
+                    break;
+            }
+            return true;
+        }
     };
 
     // Minimalistic linked list
@@ -127,10 +207,13 @@ struct CfgJsonInterface : public JsonInterface {
      * @param key The key of the setting.
      * @param value The value of the setting.
      * @param checkValue A function to check if the value is valid.
+     * @param secret (optional) Do not expose the value via the JSON API, for example a password.
      */
     template <typename T>
-    void addSetting(const String& key, T *value, std::function<bool(T)> checkValue) {
+    void addSetting(const String& key, T *value, std::function<bool(T)> checkValue, boolean secret = false) {
         SettingNode* newSetting = new SettingNode(_helper.hashStringDjb2(key.c_str()), value, checkValue);
+        newSetting->key = key;
+        newSetting->secret = secret;
         if (head == nullptr) {
             head = newSetting;
             tail = newSetting;
@@ -163,6 +246,92 @@ struct CfgJsonInterface : public JsonInterface {
         }
     }
 
+    /**
+     * @brief Export the settings as binary records keyed by the hash.
+     *
+     * @param tlv The writer to write the records to.
+     */
+    void exportToBinary(TlvWriter &tlv) {
+        SettingNode* current = head;
+        while (current != nullptr) {
+            switch (current->type) {
+                case 0:
+                    tlv.writeBool(current->hash, *current->settingCore.b->value);
+                    break;
+                case 1:
+                    tlv.writeUint16(current->hash, *current->settingCore.i->value);
+                    break;
+                case 2:
+                    tlv.writeString(current->hash, *current->settingCore.s->value);
+                    break;
+            }
+            current = current->next;
+        }
+    }
+
+    /**
+     * @brief Import the settings from binary records, unknown hashes are ignored.
+     *
+     * @param tlv The reader of the records of this configuration.
+     */
+    bool importFromBinary(TlvReader &tlv) {
+        bool success = true;
+        while (tlv.next()) {
+            SettingNode* current = head;
+            while ((current != nullptr) && (current->hash != tlv.key))
+                current = current->next;
+            if (current == nullptr)
+                continue;
+            // Matching hash found, the type needs to match as well
+            if (current->type != tlv.type) {
+                success = false;
+                continue;
+            }
+            switch (current->type) {
+                case 0: // boolean
+                    success &= current->settingCore.b->checkValueAndSet(tlv.asBool());
+                    break;
+                case 1: // uint16_t
+                    success &= current->settingCore.i->checkValueAndSet(tlv.asUint16());
+                    break;
+                case 2: // String
+                    success &= current->settingCore.s->checkValueAndSet(tlv.asString());
+                    break;
+            }
+        }
+        return success && !tlv.error;
+    }
+
+    /**
+     * @brief Write the settings with their plain keys as JSON object, secret values are null.
+     *
+     * @param json The writer to write to.
+     */
+    void writeJson(JsonWriter &json) {
+        json.beginObject();
+        SettingNode* current = head;
+        while (current != nullptr) {
+            json.writeKey(current->key.c_str());
+            if (current->secret) {
+                json.writeNull();
+            } else {
+                switch (current->type) {
+                    case 0:
+                        json.writeBool(*current->settingCore.b->value);
+                        break;
+                    case 1:
+                        json.writeUint(*current->settingCore.i->value);
+                        break;
+                    case 2:
+                        json.writeText(*current->settingCore.s->value);
+                        break;
+                }
+            }
+            current = current->next;
+        }
+        json.endObject();
+    }
+
     /**
      * @brief Import the configuration data from a JSON document.
      *
@@ -196,32 +365,6 @@ struct CfgJsonInterface : public JsonInterface {
         return success;
     }
 
-    /**
-     * @brief Update a single setting, typically from a web request.
-     *
-     * @param key The key of the setting to update, will be hashed.
-     * @param value The new value of the setting.
-     */
-    bool updateSingleValue(const String& key, const String& value) {
-        // Loop through all settings to find the correct one
-        SettingNode* current = head;
-        while (current != nullptr) {
-            if (current->hash == _helper.hashStringDjb2(key.c_str())) {
-                // Found the setting, switch to its type and check/set the value
-                switch (current->type) {
-                    case 0: // boolean
-                        return current->settingCore.b->checkValueAndSet((value.toInt() != 0));
-                    case 1: // uint16_t
-                        return current->settingCore.i->checkValueAndSet(value.toInt());
-                    case 2: // String
-                        return current->settingCore.s->checkValueAndSet(value);
-                }
-            }
-            current = current->next;
-        }
-        return false;
-    }
-
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,183 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MVP3000_CONFIG_TLV
+#define MVP3000_CONFIG_TLV
+
+#include <Arduino.h>
+
+
+/**
+ * @brief Record types of the binary configuration, the setting types match the type of the setting node.
+ */
+enum TlvType: uint8_t {
+    TLV_BOOL = 0,
+    TLV_UINT16 = 1,
+    TLV_STRING = 2,
+    TLV_INT32_ARRAY = 3,
+    TLV_FLOAT_ARRAY = 4,
+    TLV_SECTION = 5 // Nested records of one configuration
+};
+
+
+/**
+ * @brief Writes type-length-value records into a caller-provided buffer, it never allocates memory.
+ *
+ * A record is the key as djb2 hash (4 bytes), the type (1 byte), the length of the value (2 bytes), and the value.
+ * Numbers are written in the byte order of the device, the file is not meant to be moved between architectures.
+ * Writing beyond the buffer sets the overflow flag, the content is invalid then.
+ *
+ * @param buffer The buffer to write to.
+ * @param capacity The size of the buffer.
+ */
+struct TlvWriter {
+
+    uint8_t* buffer;
+    size_t capacity;
+    size_t length = 0;
+    boolean overflow = false;
+
+    TlvWriter(uint8_t* buffer, size_t capacity) : buffer(buffer), capacity(capacity) { }
+
+    void writeBool(uint32_t key, boolean value) { writeRecord(key, TLV_BOOL, &value, 1); }
+    void writeUint16(uint32_t key, uint16_t value) { writeRecord(key, TLV_UINT16, &value, sizeof(value)); }
+    void writeString(uint32_t key, const String& value) { writeRecord(key, TLV_STRING, value.c_str(), value.length()); }
+    void writeInt32Array(uint32_t key, const int32_t* values, uint8_t count) { writeRecord(key, TLV_INT32_ARRAY, values, count * sizeof(int32_t)); }
+    void writeFloatArray(uint32_t key, const float_t* values, uint8_t count) { writeRecord(key, TLV_FLOAT_ARRAY, values, count * sizeof(float_t)); }
+
+    /**
+     * @brief Start a section, all records until endSection() are its value.
+     */
+    void beginSection(uint32_t key) {
+        writeHeader(key, TLV_SECTION, 0); // Length is set at the end
+        sectionStart = length;
+    }
+
+    void endSection() {
+        if (overflow)
+            return;
+        uint16_t sectionLength = length - sectionStart;
+        memcpy(buffer + sectionStart - sizeof(uint16_t), &sectionLength, sizeof(uint16_t));
+    }
+
+    private:
+
+        size_t sectionStart = 0;
+
+        void writeHeader(uint32_t key, uint8_t type, uint16_t valueLength) {
+            writeBytes(&key, sizeof(key));
+            writeBytes(&type, 1);
+            writeBytes(&valueLength, sizeof(valueLength));
+        }
+
+        void writeRecord(uint32_t key, uint8_t type, const void* value, uint16_t valueLength) {
+            writeHeader(key, type, valueLength);
+            writeBytes(value, valueLength);
+        }
+
+        void writeBytes(const void* data, size_t len) {
+            if (length + len > capacity) {
+                overflow = true;
+                return;
+            }
+            memcpy(buffer + length, data, len);
+            length += len;
+        }
+};
+
+
+/**
+ * @brief Iterates over type-length-value records written by TlvWriter, it never copies the data.
+ *
+ * @param data The records, need to stay valid.
+ * @param length The length of the records.
+ */
+struct TlvReader {
+
+    // Current record, set by next()
+    uint32_t key = 0;
+    uint8_t type = 0;
+    uint16_t valueLength = 0;
+    const uint8_t* value = nullptr;
+
+    boolean error = false; // A record exceeds the data, the data is truncated or corrupt
+
+    TlvReader(const uint8_t* data, size_t length) : data(data), length(length) { }
+
+    /**
+     * @brief Move to the next record.
+     *
+     * @return False if there are no more records or the data is corrupt.
+     */
+    boolean next() {
+        const size_t headerLength = sizeof(key) + 1 + sizeof(valueLength);
+        if (position + headerLength > length) {
+            error = (position != length);
+            return false;
+        }
+        memcpy(&key, data + position, sizeof(key));
+        type = data[position + sizeof(key)];
+        memcpy(&valueLength, data + position + sizeof(key) + 1, sizeof(valueLength));
+        position += headerLength;
+        if (position + valueLength > length) {
+            error = true;
+            return false;
+        }
+        value = data + position;
+        position += valueLength;
+        return true;
+    }
+
+    /**
+     * @brief Reader for the records of the current section record.
+     */
+    TlvReader section() const { return TlvReader(value, valueLength); }
+
+    boolean asBool() const { return value[0] != 0; }
+
+    uint16_t asUint16() const {
+        uint16_t result;
+        memcpy(&result, value, sizeof(result));
+        return result;
+    }
+
+    String asString() const {
+        String result;
+        result.concat((const char*)value, valueLength);
+        return result;
+    }
+
+    /**
+     * @brief Copy the values of an array record.
+     *
+     * @return False if the number of values does not match.
+     */
+    template <typename T>
+    boolean asArray(T* values, uint8_t count) const {
+        if (valueLength != count * sizeof(T))
+            return false;
+        memcpy(values, value, valueLength);
+        return true;
+    }
+
+    private:
+
+        const uint8_t* data;
+        size_t length;
+        size_t position = 0;
+};
+
+#endif
@@ -22,7 +22,7 @@ extern MVP3000 mvp;
 void Led::setup() {
 
     if (!cfgLed.enabled) {
-        mvp.logger.write(CfgLogger::Level::INFO, "Led disabled.");
+        MVP3000_LOG(SYSTEM, INFO, "Led disabled.");
         return;
     }
 
@@ -87,7 +87,7 @@ void Led::checkChangeStatus() {
     // Remember current status
     ledTiming = targetTiming;
 
-    mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Led timing changed to: %d ms", targetTiming);
+    MVP3000_LOGF(SYSTEM, INFO, "Led timing changed to: %d ms", targetTiming);
 }
 
 void Led::on() {
@@ -37,19 +37,96 @@ void Logger::setup() {
     }
 
     if ((cfgLogger.target == CfgLogger::Target::NETWORK) || (cfgLogger.target == CfgLogger::Target::BOTH)) {
-        webSocketPrint = mvp.net.netWeb.registerWebSocket("/wslog");
+        // More viewers than for the data streams, the log is little traffic
+        webSocketPrint = mvp.net.netWeb.registerWebSocket("/wslog", nullptr, WebStreamClients::MAX_CLIENTS);
+        eventSource = mvp.net.netWeb.registerEventSource("/logevents", "log", std::bind(&Logger::replayEvent, this, std::placeholders::_1, std::placeholders::_2), WebStreamClients::MAX_CLIENTS);
     }
 
     write(CfgLogger::Level::INFO, "Logger initialized.");
 }
 
+void Logger::setupCfg() {
+    mvp.config.readCfg(cfgLogLevels);
+    // Levels are checked on every log call, nothing to do on change
+    mvp.net.netWeb.registerCfg(&cfgLogLevels);
+    logSyslog.setup();
+}
+
 
 //////////////////////////////////////////////////////////////////////////////////
 
-void Logger::write(CfgLogger::Level targetLevel, const String& message) {
+void Logger::loop() {
+    // Output pending messages until the time budget is used up
+    uint32_t start_us = micros();
+    while (outputNext(true) && (micros() - start_us < outputBudget_us))
+        ;
+    logSyslog.loop();
+}
+
+void Logger::flush() {
+    while (outputNext(false))
+        ;
+}
+
+void Logger::write(CfgLogger::Level targetLevel, const char* message) {
+    uint32_t eventId = ++lastEventId;
+
+    // Remember if any error was reported
+    if (targetLevel == CfgLogger::Level::ERROR)
+        errorReported = true;
+
+    // Not printed and not stored for web display, nothing to do
+    if (!checkTargetLevel(targetLevel) && (targetLevel > CfgLogger::Level::CONTROL))
+        return;
+
+    // Recorded right away, a message still in the ring is not lost on a crash
+    if (targetLevel <= CfgLogger::Level::CONTROL)
+        mvp.flightRecorder.recordLog(targetLevel, eventId, message);
+
+    // Data lines come from the main loop and can be longer than a ring record, print them directly after everything queued
+    size_t length = strlen(message);
+    if ((targetLevel == CfgLogger::Level::DATA) && (length > LogRing::MAX_LENGTH)) {
+        flush();
+        output({ (uint32_t)millis(), eventId, targetLevel, (uint16_t)length }, message);
+        return;
+    }
+
+    // Only copy the message now, the timestamp string, serial and network output follow in loop()
+    logRing.push({ (uint32_t)millis(), eventId, targetLevel, (uint16_t)min(length, (size_t)UINT16_MAX) }, message);
+
+    // During setup there is no loop yet
+    if (!deferred)
+        flush();
+}
+
+bool Logger::outputNext(boolean nonBlocking) {
+    LogRing::Header header;
+    if (!logRing.peek(header, outputMessage))
+        return false;
+
+    // Printing to a full serial buffer blocks, wait for the next loop instead
+    if (nonBlocking && checkTargetLevel((CfgLogger::Level)header.level) && ((cfgLogger.target == CfgLogger::Target::CONSOLE) || (cfgLogger.target == CfgLogger::Target::BOTH))) {
+        // Timestamp, level and colors add some 30 chars
+        if (Serial.availableForWrite() < min(header.length + 30, (int)serialFifo))
+            return false;
+    }
+
+    logRing.pop(header);
+    output(header, outputMessage);
+
+    // Report lost messages once there is room again
+    uint32_t dropped = logRing.takeDropPending();
+    if (dropped > 0)
+        writeFormatted(CfgLogger::Level::WARNING, "%lu log messages dropped, ring full.", (unsigned long)dropped);
+    return true;
+}
+
+void Logger::output(const LogRing::Header& header, const char* message) {
+    CfgLogger::Level targetLevel = (CfgLogger::Level)header.level;
+
     // Store errors, warnings, usermsg for web display
     if (targetLevel <= CfgLogger::Level::CONTROL) {
-        linkedListLog.append(targetLevel, message);
+        linkedListLog.append(targetLevel, message, header.id, header.time_ms);
     }
 
     if (!checkTargetLevel(targetLevel))
@@ -57,50 +134,66 @@ void Logger::write(CfgLogger::Level targetLevel, const String& message) {
 
     // Serial output
     if ((cfgLogger.target == CfgLogger::Target::CONSOLE) || (cfgLogger.target == CfgLogger::Target::BOTH)) {
-        serialPrint(targetLevel, message);
+        serialPrint(targetLevel, header.time_ms, message);
     }
     // Network output, omit DATA level
     if ( ((cfgLogger.target == CfgLogger::Target::NETWORK) || (cfgLogger.target == CfgLogger::Target::BOTH)) && (targetLevel != CfgLogger::Level::DATA) ) {
-        webSocketPrint(_helper.millisToTime(millis()) + " " + message);
+        StringBuffer<LogRing::MAX_LENGTH + 24> networkMessage;
+        networkMessage.appendTime(header.time_ms).append(' ').append(message);
+        webSocketPrint(networkMessage.c_str());
+        if (eventSource != nullptr)
+            eventSource->sendAll(networkMessage.c_str(), header.id);
+        logSyslog.write(targetLevel, header.time_ms, header.id, message);
     }
 }
 
+uint32_t Logger::replayEvent(uint32_t lastId, const char*& message) {
+    // Oldest stored entry newer than the last one the client received
+    DataStructLog* entry = nullptr;
+    linkedListLog.loop([&](DataStructLog*& current, uint16_t i) {
+        if ((entry == nullptr) && (current->id > lastId))
+            entry = current;
+    });
+    if (entry == nullptr)
+        return 0;
+    replayMessage.clear();
+    replayMessage.appendTime(entry->time).append(' ').append(entry->message);
+    message = replayMessage.c_str();
+    return entry->id;
+}
+
 void Logger::writeCSV(CfgLogger::Level targetLevel, int32_t* dataArray, uint8_t dataLength, uint8_t matrixColumnCount) {
-    String message;
+    // Up to 12 chars per value, data lines are not limited to the ring record length
+    size_t bufferSize = 12 * dataLength + 1;
+    char* buffer = new char[bufferSize];
+    StringBuilder message(buffer, bufferSize);
     for (uint8_t i = 0; i < dataLength; i++) {
         // Outputs:
         //  1,2,3,4,5,6; for rowLength is max uint8/255
         //  1,2,3;4,5,6; for rowLength is 3
         // matrixColumnCount defaults to 255, which is the maximum length of a single row
-        message += dataArray[i];
-        message += ((i == dataLength - 1) || ((i + 1) % (matrixColumnCount) == 0) ) ? ";" : "," ;
+        message.appendInt(dataArray[i]);
+        message.append(((i == dataLength - 1) || ((i + 1) % (matrixColumnCount) == 0) ) ? ';' : ',');
     }
     write(targetLevel, message.c_str());
+    delete[] buffer;
 }
 
 void Logger::writeFormatted(CfgLogger::Level targetLevel, const String& formatString, ...) {
-    // This is a copy from Helper::printFormatted - for some reason we cannot call it from here
+    // Formatted once into a buffer of the longest message the ring takes
+    StringBuffer<LogRing::MAX_LENGTH + 1> message;
     va_list args;
     va_start(args, formatString);
-
-    // Get length incl termination
-    uint8_t len = vsnprintf(nullptr, 0, formatString.c_str(), args) + 1;
-    char message[len];
-    vsnprintf(message, sizeof(message), formatString.c_str(), args);
-
+    message.appendFormattedV(formatString.c_str(), args);
     va_end(args);
 
-    write(targetLevel, message);
+    write(targetLevel, message.c_str());
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////
 
 bool Logger::checkTargetLevel(CfgLogger::Level targetLevel) {
-    // Remember if any error was reported
-    if (targetLevel == CfgLogger::Level::ERROR)
-        errorReported = true;
-
     // Logging is turned off, nothing to do
     if (cfgLogger.target == CfgLogger::Target::NONE)
         return false;
@@ -112,18 +205,21 @@ bool Logger::checkTargetLevel(CfgLogger::Level targetLevel) {
     return true;
 }
 
-void Logger::serialPrint(CfgLogger::Level targetLevel, const String& message) {
-    // Prefix with timestamp
-    Serial.print(_helper.millisToTime(millis()));
+void Logger::serialPrint(CfgLogger::Level targetLevel, uint32_t time, const char* message) {
+    // The whole line is built first and written at once
+    StringBuffer<LogRing::MAX_LENGTH + 40> line;
+
+    // Prefix with timestamp of the message, not of the output
+    line.appendTime(time);
 
     // Add type literal
     switch (targetLevel) {
-        case CfgLogger::Level::CONTROL: Serial.print(" [C] "); break;
-        case CfgLogger::Level::DATA: Serial.print(" [D] "); break;
-        case CfgLogger::Level::ERROR : Serial.print(" [E] "); break;
-        case CfgLogger::Level::INFO: Serial.print(" [I] "); break;
-        case CfgLogger::Level::USER: Serial.print(" [U] "); break;
-        case CfgLogger::Level::WARNING: Serial.print(" [W] "); break;
+        case CfgLogger::Level::CONTROL: line.append(" [C] "); break;
+        case CfgLogger::Level::DATA: line.append(" [D] "); break;
+        case CfgLogger::Level::ERROR : line.append(" [E] "); break;
+        case CfgLogger::Level::INFO: line.append(" [I] "); break;
+        case CfgLogger::Level::USER: line.append(" [U] "); break;
+        case CfgLogger::Level::WARNING: line.append(" [W] "); break;
     }
 
     // Color-code messages for easier readability
@@ -137,23 +233,31 @@ void Logger::serialPrint(CfgLogger::Level targetLevel, const String& message) {
     // To reset: \033[0m
     if (cfgLogger.ansiColor) {
         switch (targetLevel) {
-            case CfgLogger::Level::CONTROL: Serial.print("\033[32m"); break; // green
-            case CfgLogger::Level::DATA: Serial.print("\033[34m"); break; // blue
-            case CfgLogger::Level::ERROR : Serial.print("\033[31;1m"); break; // red, bold
-            case CfgLogger::Level::INFO: Serial.print("\033[90m"); break; // bright black, also called dark grey by commoners
-            case CfgLogger::Level::USER: Serial.print("\033[95;1m"); break; // magenta, bold
-            case CfgLogger::Level::WARNING: Serial.print("\033[33m"); break; // yellow
+            case CfgLogger::Level::CONTROL: line.append("\033[32m"); break; // green
+            case CfgLogger::Level::DATA: line.append("\033[34m"); break; // blue
+            case CfgLogger::Level::ERROR : line.append("\033[31;1m"); break; // red, bold
+            case CfgLogger::Level::INFO: line.append("\033[90m"); break; // bright black, also called dark grey by commoners
+            case CfgLogger::Level::USER: line.append("\033[95;1m"); break; // magenta, bold
+            case CfgLogger::Level::WARNING: line.append("\033[33m"); break; // yellow
         }
     }
 
-    // Print actual message
-    Serial.print(message);
+    // Print actual message, a data line longer than a ring record is written on its own
+    size_t messageLength = strlen(message);
+    if (messageLength > LogRing::MAX_LENGTH) {
+        Serial.write(line.c_str(), line.length());
+        Serial.write(message, messageLength);
+        line.clear();
+    } else {
+        line.append(message);
+    }
 
     // Reset ansi text formatting and end line
     if (cfgLogger.ansiColor) {
-        Serial.print("\033[0m");
+        line.append("\033[0m");
     }
-    Serial.println("");
+    line.append("\r\n");
+    Serial.write(line.c_str(), line.length());
 }
 
 
@@ -161,17 +265,43 @@ void Logger::serialPrint(CfgLogger::Level targetLevel, const String& message) {
 
 String Logger::templateProcessor(uint8_t var) {
     switch (var) {
+        case 31:
+            return String(logRing.countDropped);
+        case 32:
+            return String(MVP3000_LOG_LEVEL);
+        case 33:
+        case 34:
+        case 35:
+        case 36:
+        case 37:
+        case 38:
+            return String(cfgLogLevels.levels[var - 33]);
+        case 39:
+            return logSyslog.templateHtml();
+        default:
+            return "";
+    }
+}
 
-        case 30:
+boolean Logger::templateListProcessor(uint8_t var, uint16_t index, String& row) {
+    switch (var) {
+        case 30: // Recent entries, newest first
             if (linkedListLog.getSize() == 0) {
-                return "-";
+                row = "-";
+                return (index == 0);
             }
-            // Set initial bookmark
-            linkedListLog.bookmarkByIndex(0, true);
-        case 31:
-            return _helper.printFormatted("<li>%s %s %s</li>", _helper.millisToTime(linkedListLog.getBookmarkData()->time).c_str(), linkedListLog.getBookmarkData()->message.c_str(), (linkedListLog.moveBookmark(true)) ? "<br> %31%" : "");
+            {
+                // The index is the cursor of the request, the list is short
+                DataStructLog* entry = linkedListLog.getDataByIndex(index, true);
+                if (entry == nullptr)
+                    return false;
+                StringBuffer<LogRing::MAX_LENGTH + 40> line;
+                line.append("<li>").appendTime(entry->time).append(' ').append(entry->message).append("</li> ");
+                row = line.c_str();
+            }
+            return true;
 
         default:
-            return "";
+            return false;
     }
 }
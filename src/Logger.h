@@ -21,6 +21,33 @@ limitations under the License.
 #include <stdarg.h>
 
 #include "_Helper_LinkedList.h"
+#include "_Helper_StringBuilder.h"
+#include "Config_JsonInterface.h"
+#include "Logger_Ring.h"
+#include "Logger_Syslog.h"
+
+struct DataStructEventSource; // See NetWeb_WebStructs.h
+
+
+// Highest level compiled in, calls above it are removed by the compiler including the evaluation of their arguments
+// Set with a build flag, for example -D MVP3000_LOG_LEVEL=1 for errors and warnings only
+#ifndef MVP3000_LOG_LEVEL
+    #define MVP3000_LOG_LEVEL 5
+#endif
+
+// Log a plain message of a subsystem: MVP3000_LOG(NET, INFO, "Message.");
+#define MVP3000_LOG(subsystem, level, message) \
+    do { \
+        if ((CfgLogger::Level::level <= MVP3000_LOG_LEVEL) && mvp.logger.isEnabled(CfgLogger::Subsystem::subsystem, CfgLogger::Level::level)) \
+            mvp.logger.write(CfgLogger::Level::level, message); \
+    } while (0)
+
+// Log a formatted message of a subsystem: MVP3000_LOGF(NET, INFO, "Connected to %s.", ssid.c_str());
+#define MVP3000_LOGF(subsystem, level, ...) \
+    do { \
+        if ((CfgLogger::Level::level <= MVP3000_LOG_LEVEL) && mvp.logger.isEnabled(CfgLogger::Subsystem::subsystem, CfgLogger::Level::level)) \
+            mvp.logger.writeFormatted(CfgLogger::Level::level, __VA_ARGS__); \
+    } while (0)
 
 
 
@@ -43,6 +70,15 @@ struct CfgLogger {
         BOTH = 3,
     };
 
+    enum Subsystem: uint8_t {
+        SYSTEM = 0,
+        CONFIG = 1,
+        NET = 2,
+        WEB = 3,
+        MQTT = 4,
+        SENSOR = 5,
+    };
+
     Level level = Level::INFO;
 
     Target target = Target::BOTH;
@@ -50,6 +86,22 @@ struct CfgLogger {
     boolean ansiColor = true;
 };
 
+struct CfgLogLevels : public CfgJsonInterface {
+
+    // Modifiable settings saved to SPIFF
+
+    uint16_t levels[6] = { CfgLogger::Level::INFO, CfgLogger::Level::INFO, CfgLogger::Level::INFO, CfgLogger::Level::INFO, CfgLogger::Level::INFO, CfgLogger::Level::INFO }; // Index is the subsystem
+
+    CfgLogLevels() : CfgJsonInterface("cfgLogLevels") {
+        addSetting<uint16_t>("logSystem", &levels[CfgLogger::Subsystem::SYSTEM], [](uint16_t x) { return (x <= CfgLogger::Level::INFO); });
+        addSetting<uint16_t>("logConfig", &levels[CfgLogger::Subsystem::CONFIG], [](uint16_t x) { return (x <= CfgLogger::Level::INFO); });
+        addSetting<uint16_t>("logNet", &levels[CfgLogger::Subsystem::NET], [](uint16_t x) { return (x <= CfgLogger::Level::INFO); });
+        addSetting<uint16_t>("logWeb", &levels[CfgLogger::Subsystem::WEB], [](uint16_t x) { return (x <= CfgLogger::Level::INFO); });
+        addSetting<uint16_t>("logMqtt", &levels[CfgLogger::Subsystem::MQTT], [](uint16_t x) { return (x <= CfgLogger::Level::INFO); });
+        addSetting<uint16_t>("logSensor", &levels[CfgLogger::Subsystem::SENSOR], [](uint16_t x) { return (x <= CfgLogger::Level::INFO); });
+    }
+};
+
 
 class Logger {
 
@@ -57,55 +109,113 @@ class Logger {
 
         boolean errorReported = false;
 
+        LogSyslog logSyslog; // Network output to a syslog server
+
         void setup();
+        void setupCfg(); // Needs the config, which is set up after the logger
+        void loop();
+
+        // Output all pending messages, blocking
+        void flush();
+        // Queue messages and output them from loop() instead of right away, set once setup is complete
+        void setDeferred(boolean enable) { deferred = enable; }
 
         void ansiColor(boolean enable) { cfgLogger.ansiColor = enable; }
 
+        /**
+         * @brief Check the level of a subsystem before paying for formatting, used by the MVP3000_LOG macros.
+         *
+         * Errors always pass as they set the error state. Errors, warnings, user and control messages are also stored for the web page if the output level is lower.
+         */
+        boolean isEnabled(CfgLogger::Subsystem subsystem, CfgLogger::Level targetLevel) const {
+            if (targetLevel == CfgLogger::Level::ERROR)
+                return true;
+            if (targetLevel > cfgLogLevels.levels[subsystem])
+                return false;
+            return (targetLevel <= CfgLogger::Level::CONTROL) || ((targetLevel <= cfgLogger.level) && (cfgLogger.target != CfgLogger::Target::NONE));
+        }
+
         // Plain test output
-        void write(CfgLogger::Level targetLevel, const String& message);
+        void write(CfgLogger::Level targetLevel, const char* message);
+        void write(CfgLogger::Level targetLevel, const String& message) { write(targetLevel, message.c_str()); }
         // Output data in CSV format
         void writeCSV(CfgLogger::Level targetLevel, int32_t* dataArray, uint8_t dataLength, uint8_t matrixColumnCount);
         // Formatted output: writeFormatted(CfgLogger::Level::INFO, "This is the string '%s' and the number %d", "Hello World", 42);
         void writeFormatted(CfgLogger::Level targetLevel, const String& formatString, ...);
 
+        // Messages written since boot, any level
+        uint32_t countLines() const { return lastEventId; }
+        // Messages lost because the ring was full
+        uint32_t countDropped() const { return logRing.countDropped; }
+
     private:
 
         struct DataStructLog {
             uint64_t time;
             uint8_t level;
             String message;
+            uint32_t id; // Event id of the log stream
 
-            DataStructLog(const String& message, uint8_t level) : time(millis()), message(message), level(level) { }
+            DataStructLog(const String& message, uint8_t level, uint32_t id, uint32_t time) : time(time), message(message), level(level), id(id) { }
         };
 
         struct LinkedListLog : LinkedList3010<DataStructLog> {
             LinkedListLog(uint16_t size) : LinkedList3010<DataStructLog>(size) { }
 
-            void append(uint8_t level, const String& message) {
+            void append(uint8_t level, const String& message, uint32_t id, uint32_t time) {
                 // Create data structure and add node to linked list
                 // Using this-> as base class/function is templated
-                this->appendDataStruct(new DataStructLog(message, level));
+                this->appendDataStruct(new DataStructLog(message, level, id, time));
             }
         };
 
 
         CfgLogger cfgLogger;
+        CfgLogLevels cfgLogLevels;
 
         uint8_t logStoreLength = 5;
         LinkedListLog linkedListLog = LinkedListLog(logStoreLength);
 
+        // Messages are formatted and printed later from loop(), the ring holds them until then
+        LogRing logRing = LogRing(2048);
+        uint16_t outputBudget_us = 1000; // Time per loop for output, at least one message is printed
+        const uint8_t serialFifo = 128; // Hardware FIFO, larger messages wait for an empty FIFO
+        boolean deferred = false;
+        char outputMessage[LogRing::MAX_LENGTH + 1];
+
+        bool outputNext(boolean nonBlocking);
+        void output(const LogRing::Header& header, const char* message);
+
         bool checkTargetLevel(CfgLogger::Level targetLevel);
 
-        void serialPrint(CfgLogger::Level targetLevel, const String& message);
+        void serialPrint(CfgLogger::Level targetLevel, uint32_t time, const char* message);
 
         std::function<void(const String& message)> webSocketPrint; // Function to print to the websocket
 
+        // Event stream, only the stored entries can be replayed to a reconnecting client
+        DataStructEventSource* eventSource = nullptr;
+        uint32_t lastEventId = 0;
+        StringBuffer<LogRing::MAX_LENGTH + 24> replayMessage;
+        uint32_t replayEvent(uint32_t lastId, const char*& message);
+
     public:
 
         String templateProcessor(uint8_t var);
+        boolean templateListProcessor(uint8_t var, uint16_t index, String& row);
         const char* webPage = R"===(
 <h3>Log</h3> <ul>
 <li>Log websocket: ws://%2%/wslog </li>
+<li>Log event stream: http://%2%/logevents </li>
+<li>Dropped messages: %31% </li>
+<li>Subsystem levels: 0 error, 1 warning, 2 user, 3 control, 4 data, 5 info. Levels above %32% are not compiled in.<br> <form action='/save' method='post'>
+System <input name='logSystem' value='%33%' type='number' min='0' max='5'>
+Config <input name='logConfig' value='%34%' type='number' min='0' max='5'>
+Net <input name='logNet' value='%35%' type='number' min='0' max='5'>
+Web <input name='logWeb' value='%36%' type='number' min='0' max='5'>
+MQTT <input name='logMqtt' value='%37%' type='number' min='0' max='5'>
+Sensor <input name='logSensor' value='%38%' type='number' min='0' max='5'>
+<input type='submit' value='Save'> </form> </li>
+%39%
 <li>Recent entries: <ul> %30% </ul> </li> </ul>
 )===";
 
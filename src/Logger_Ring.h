@@ -0,0 +1,155 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef MVP3000_LOGGER_RING
+#define MVP3000_LOGGER_RING
+
+#include <Arduino.h>
+
+
+/**
+ * @brief Preallocated byte ring of pending log records.
+ *
+ * A record is a fixed header followed by the message bytes, records are packed without gaps and may wrap around the end of the buffer.
+ * Pushing only copies bytes, no memory is allocated after construction. If a record does not fit it is dropped and counted.
+ * Messages are also written from the web server and WiFi event tasks, so every access to the ring is a short critical section.
+ */
+struct LogRing {
+
+    struct Header {
+        uint32_t time_ms;
+        uint32_t id; // Event id of the log stream
+        uint8_t level;
+        uint16_t length; // Message bytes following the header
+    };
+
+    static const uint16_t MAX_LENGTH = 192; // Longer messages are truncated and end with TRUNCATED_MARK
+
+    uint32_t countDropped = 0; // Records lost since boot because the ring was full
+
+    LogRing(uint16_t _capacity) : capacity(_capacity) { buffer = new uint8_t[capacity]; }
+    ~LogRing() { delete[] buffer; }
+
+    boolean isEmpty() const { return used == 0; }
+
+    /**
+     * @brief Copy a record into the ring.
+     *
+     * @param header The record header, the length is the number of message bytes.
+     * @param message The message, truncated to MAX_LENGTH.
+     * @return False if the ring is full and the record was dropped.
+     */
+    boolean push(Header header, const char* message) {
+        uint16_t messageLength = header.length;
+        if (header.length > MAX_LENGTH) {
+            header.length = MAX_LENGTH;
+            messageLength = MAX_LENGTH - strlen(TRUNCATED_MARK);
+        }
+
+        lock();
+        if (used + sizeof(Header) + header.length > capacity) {
+            countDropped++;
+            dropPending++;
+            unlock();
+            return false;
+        }
+        put(&header, sizeof(Header));
+        put(message, messageLength);
+        if (messageLength < header.length)
+            put(TRUNCATED_MARK, header.length - messageLength);
+        unlock();
+        return true;
+    }
+
+    /**
+     * @brief Look at the oldest record without removing it.
+     *
+     * @param header Returns the record header.
+     * @param message Returns the null-terminated message, needs room for MAX_LENGTH + 1 bytes.
+     */
+    boolean peek(Header& header, char* message) {
+        lock();
+        if (used == 0) {
+            unlock();
+            return false;
+        }
+        uint16_t offset = get(tail, &header, sizeof(Header));
+        // Never trust the length to be within the message buffer
+        if (header.length > MAX_LENGTH)
+            header.length = MAX_LENGTH;
+        get(offset, message, header.length);
+        unlock();
+        message[header.length] = '\0';
+        return true;
+    }
+
+    // Remove the oldest record after peek, only one context reads from the ring
+    void pop(const Header& header) {
+        uint16_t length = sizeof(Header) + header.length;
+        lock();
+        tail = (tail + length) % capacity;
+        used -= length;
+        unlock();
+    }
+
+    // Dropped records not yet reported in the output, resets the count
+    uint32_t takeDropPending() {
+        lock();
+        uint32_t count = dropPending;
+        dropPending = 0;
+        unlock();
+        return count;
+    }
+
+    private:
+
+        uint8_t* buffer;
+        uint16_t capacity;
+        uint16_t head = 0; // Next byte to write
+        uint16_t tail = 0; // Oldest byte
+        uint16_t used = 0;
+        uint32_t dropPending = 0;
+
+        const char* TRUNCATED_MARK = "...";
+
+#if defined(ESP32)
+        portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+        void lock() { portENTER_CRITICAL(&mux); }
+        void unlock() { portEXIT_CRITICAL(&mux); }
+#else
+        void lock() { noInterrupts(); }
+        void unlock() { interrupts(); }
+#endif
+
+        void put(const void* data, uint16_t length) {
+            // Copy in up to two parts when wrapping around the end
+            uint16_t first = min(length, (uint16_t)(capacity - head));
+            memcpy(buffer + head, data, first);
+            memcpy(buffer, (const uint8_t*)data + first, length - first);
+            head = (head + length) % capacity;
+            used += length;
+        }
+
+        uint16_t get(uint16_t offset, void* data, uint16_t length) const {
+            uint16_t first = min(length, (uint16_t)(capacity - offset));
+            memcpy(data, buffer + offset, first);
+            memcpy((uint8_t*)data + first, buffer, length - first);
+            return (offset + length) % capacity;
+        }
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "Logger_Syslog.h"
+
+#include "MVP3000.h"
+extern MVP3000 mvp;
+
+#include "_Helper.h"
+extern _Helper _helper;
+
+
+void LogSyslog::setup() {
+    mvp.config.readCfg(cfgLogSyslog);
+    // Settings are read on every message, nothing to do on change
+    mvp.net.netWeb.registerCfg(&cfgLogSyslog);
+}
+
+void LogSyslog::loop() {
+    // Send a partial batch once its first message is old enough, keep it while there is no connection
+    if ((batchCount > 0) && (millis() - batchStart_ms >= batchDelay_ms) && mvp.net.connectedAsClient())
+        send();
+}
+
+void LogSyslog::write(uint8_t level, uint32_t time_ms, uint32_t id, const char* message) {
+    if (!cfgLogSyslog.syslogEnabled)
+        return;
+
+    // RFC 5424: <PRI>VERSION TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG
+    // There is no wall clock, the timestamp is nil and the uptime is sent in hundredths of a second with the meta structured data
+    // Facility is local0 (16), severity from the level: error, warning, notice, notice, debug, info
+    const uint8_t severity[6] = { 3, 4, 5, 5, 7, 6 };
+    StringBuffer<320> line;
+    line.append('<').appendUint(16 * 8 + severity[(level < 6) ? level : 5]).append(">1 - MVP3000_").appendUint(_helper.ESPX->getChipId()).append(" MVP3000 - - ");
+    line.append("[meta sequenceId=\"").appendUint(id).append("\" sysUpTime=\"").appendUint(time_ms / 10).append("\"] ").append(message);
+
+    // Send the previous messages first if this one does not fit, a datagram without connection is dropped
+    // RFC 5426 allows only one message per datagram, without batching a waiting message is sent on its own
+    if ((batchCount > 0) && (!cfgLogSyslog.syslogBatch || (batchLength + 1 + line.length() > sizeof(batch))))
+        send();
+
+    if (batchCount > 0)
+        batch[batchLength++] = '\n';
+    else
+        batchStart_ms = millis();
+    memcpy(batch + batchLength, line.c_str(), line.length());
+    batchLength += line.length();
+    batchCount++;
+
+    if (!cfgLogSyslog.syslogBatch && mvp.net.connectedAsClient())
+        send();
+}
+
+String LogSyslog::templateHtml() {
+    StringBuffer<1024> html;
+    html.append("<li>Syslog, RFC 5424 over UDP: ");
+    appendStatus(html);
+    html.append("<br> <form action='/save' method='post'> <input name='syslogEnabled' type='checkbox' ").append(cfgLogSyslog.syslogEnabled ? "checked" : "").append(" value='1'> <input name='syslogEnabled' type='hidden' value='0'> Enable ");
+    html.append("<input name='syslogBatch' type='checkbox' ").append(cfgLogSyslog.syslogBatch ? "checked" : "").append(" value='1'> <input name='syslogBatch' type='hidden' value='0'> Batch (not RFC 5426, bundled listener only) ");
+    html.append("Host <input name='syslogHost' value='").append(cfgLogSyslog.syslogHost).append("' placeholder='discovered LOG server'> ");
+    html.append("Port <input name='syslogPort' value='").appendUint(cfgLogSyslog.syslogPort).append("' type='number' min='1' max='65535'> <input type='submit' value='Save'> </form> </li>");
+    return html.c_str();
+}
+
+void LogSyslog::appendStatus(StringBuilder& text) {
+    if (!cfgLogSyslog.syslogEnabled) {
+        text.append("disabled");
+        return;
+    }
+    IPAddress target = getTarget();
+    if (target == INADDR_NONE)
+        text.append("no target");
+    else
+        text.append(target.toString()).append(':').appendUint(cfgLogSyslog.syslogPort);
+    text.append(", ").appendUint(countSent).append(" datagrams sent, ").appendUint(countDropped).append(" messages dropped");
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////
+
+IPAddress LogSyslog::getTarget() {
+    // Configured address first, otherwise the server found by UDP discovery
+    IPAddress target;
+    if ((cfgLogSyslog.syslogHost.length() > 0) && target.fromString(cfgLogSyslog.syslogHost))
+        return target;
+    return mvp.net.netCom.checkSkill("LOG");
+}
+
+void LogSyslog::send() {
+    IPAddress target = getTarget();
+    // Handing the datagram to the network stack does not wait for the network
+    if (mvp.net.connectedAsClient() && (target != INADDR_NONE) && udp.beginPacket(target, cfgLogSyslog.syslogPort)) {
+        udp.write((const uint8_t*)batch, batchLength);
+        if (udp.endPacket())
+            countSent++;
+        else
+            countDropped += batchCount;
+    } else {
+        countDropped += batchCount;
+    }
+    batchLength = 0;
+    batchCount = 0;
+}
@@ -0,0 +1,100 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef MVP3000_LOGGER_SYSLOG
+#define MVP3000_LOGGER_SYSLOG
+
+#include <Arduino.h>
+#if defined(ESP8266)
+    #include <ESP8266WiFi.h>
+#else
+    #include <WiFi.h>
+    #include <IPAddress.h>
+#endif
+#include <WiFiUdp.h>
+
+#include "Config_JsonInterface.h"
+#include "_Helper_StringBuilder.h"
+
+
+struct CfgLogSyslog : public CfgJsonInterface {
+
+    // Modifiable settings saved to SPIFF
+
+    boolean syslogEnabled = false;
+    String syslogHost = ""; // IP address, empty to use the server with the LOG skill found by UDP discovery
+    uint16_t syslogPort = 514;
+    boolean syslogBatch = false; // Several messages per datagram, separated by newline, not RFC 5426 compliant, for the bundled listener
+
+    CfgLogSyslog() : CfgJsonInterface("cfgLogSyslog") {
+        addSetting<boolean>("syslogEnabled", &syslogEnabled, [](boolean _) { return true; });
+        addSetting<String>("syslogHost", &syslogHost, [](const String& x) { IPAddress ip; return (x.length() == 0) || ip.fromString(x); }); // Name resolution would block
+        addSetting<uint16_t>("syslogPort", &syslogPort, [](uint16_t x) { return (x > 0); });
+        addSetting<boolean>("syslogBatch", &syslogBatch, [](boolean _) { return true; });
+    }
+};
+
+
+/**
+ * @brief Sends the log to a syslog server as RFC 5424 messages over UDP.
+ *
+ * Messages are collected in a fixed buffer and sent as one datagram when it is full or after a short delay, sending never waits for the network.
+ * Without WiFi client connection or target the messages are dropped and counted.
+ */
+class LogSyslog {
+
+    public:
+
+        uint32_t countSent = 0; // Datagrams
+        uint32_t countDropped = 0; // Messages
+
+        void setup();
+        void loop();
+
+        /**
+         * @brief Add a message to the batch.
+         *
+         * @param level Log level, mapped to the syslog severity.
+         * @param time_ms Time of the message, sent as uptime.
+         * @param id Event id of the log stream, sent as sequence id.
+         * @param message The message.
+         */
+        void write(uint8_t level, uint32_t time_ms, uint32_t id, const char* message);
+
+        // List entry with status and settings form for the log page
+        String templateHtml();
+
+    private:
+
+        CfgLogSyslog cfgLogSyslog;
+
+        WiFiUDP udp;
+
+        // Safe UDP payload size without fragmentation
+        char batch[512];
+        uint16_t batchLength = 0;
+        uint16_t batchCount = 0;
+        uint32_t batchStart_ms = 0;
+        uint16_t batchDelay_ms = 1000; // Longest time a message waits for more
+
+        IPAddress getTarget();
+        void send();
+
+        void appendStatus(StringBuilder& text);
+};
+
+#endif
@@ -24,13 +24,20 @@ MVP3000 mvp;
 
 
 void MVP3000::setup() {
+    // Take over the record of the previous boot before anything is logged
+    flightRecorder.begin();
+    bootProfile.start();
     // Start logging first obviously
     logger.setup();
+    flightRecorder.dumpToLog();
+    bootProfile.mark(BootProfile::LOGGER);
     // Prepare flash to allow loading of saved configs
     config.setup();
+    config.readCfg(bootProfile); // Previous boot
+    logger.setupCfg();
+    bootProfile.mark(BootProfile::CONFIG);
     led.setup();
-
-    net.setup();
+    bootProfile.mark(BootProfile::LED);
 
     // Register actions
     net.netWeb.registerAction("restart", [&](int args, WebArgKeyValue argKey, WebArgKeyValue argValue) {
@@ -41,22 +48,52 @@ void MVP3000::setup() {
         config.asyncFactoryResetDevice((args == 3) && (argKey(2) == "keepwifi")); // If keepwifi is checked it is present in the args, otherwise not
         return true;
     }, "Factory reset initiated, this takes some 10 s ...");
+    registerMetrics();
 
-    // Modules
+    // Modules first, they can take samples right away, the data is stored until the network is up
+    bootProfile.start();
     for (uint8_t i = 0; i < moduleCount; i++) {
         xmodules[i]->setup();
     }
+    bootProfile.mark(BootProfile::MODULES);
+
+    // The network comes up in stages from loop()
+    net.setup();
+
+    // From now on log output is printed from loop(), not by the caller
+    logger.setDeferred(true);
+    flightRecorder.phase(FlightRecorder::Phase::USER);
 }
 
 void MVP3000::loop() {
+    flightRecorder.startLoop();
     updateLoopDuration();
     checkStatus();
 
+    // Network stages are done, all configs are read
+    if (!setupDone && net.isSetupDone()) {
+        setupDone = true;
+        config.finishLoading();
+        bootProfile.milestone(BootProfile::SETUP_DONE);
+    }
+
+    // Keep the profile of this boot for the next one
+    if (bootProfile.isSaveDue()) {
+        bootProfile.saved = true;
+        config.writeCfg(bootProfile);
+    }
+
+    flightRecorder.phase(FlightRecorder::Phase::LOGGER);
+    logger.loop();
+    flightRecorder.phase(FlightRecorder::Phase::CONFIG);
     config.loop();
+    flightRecorder.phase(FlightRecorder::Phase::LED);
     led.loop();
+    flightRecorder.phase(FlightRecorder::Phase::NET);
     net.loop();
     // Modules
     for (uint8_t i = 0; i < moduleCount; i++) {
+        flightRecorder.phase(FlightRecorder::Phase::MODULE, i);
         xmodules[i]->loop();
     }
 
@@ -64,9 +101,14 @@ void MVP3000::loop() {
     if (delayedRestart_ms > 0) {
         if (millis() > delayedRestart_ms) {
             // delayedRestart_ms = 0; // Not needed as we reset the ESP
+            config.flush();
+            logger.flush();
+            flightRecorder.phase(FlightRecorder::Phase::RESTART);
             _helper.ESPX->reset();
         }
     }
+
+    flightRecorder.phase(FlightRecorder::Phase::USER);
 }
 
 void MVP3000::addXmodule(_Xmodule *xmodule) {
@@ -106,6 +148,7 @@ void MVP3000::updateLoopDuration() {
     if (loopLast_ms > 0) {
         // Current loop duration
         uint16_t loopDuration = millis() - loopLast_ms;
+        loopHistogram.observe((micros() - loopLast_us) / 1000.0);
 
         // Update min and max loop duration
         loopDurationMax_ms = max(loopDurationMax_ms, loopDuration);
@@ -122,42 +165,165 @@ void MVP3000::updateLoopDuration() {
 
     // Remember this loop time
     loopLast_ms = millis();
+    loopLast_us = micros();
+
+    heapFreeMin = min(heapFreeMin, ESP.getFreeHeap());
+}
+
+void MVP3000::registerMetrics() {
+    metrics.addGauge("uptime_seconds", "Time since boot.", []() { return millis() / 1000.0; });
+    metrics.addGauge("heap_free_bytes", "Free heap.", []() { return ESP.getFreeHeap(); });
+    metrics.addGauge("heap_free_min_bytes", "Lowest free heap since the device is up.", [&]() { return min(heapFreeMin, ESP.getFreeHeap()); });
+    metrics.addGauge("heap_fragmentation_percent", "Heap fragmentation.", []() { return _helper.ESPX->getHeapFragmentation(); });
+    metrics.addHistogram("loop_duration_ms", "Duration of the main loop.", &loopHistogram);
+    metrics.addCounter("config_writes_total", "Configurations written to flash.", [&]() { return config.countWrites; });
+    metrics.addCounter("config_written_bytes_total", "Bytes of configurations written to flash.", [&]() { return config.countBytesWritten; });
+    metrics.addGauge("config_load_seconds", "Time spent reading the configurations at boot.", [&]() { return config.loadTime_us / 1000000.0; });
+    metrics.addGauge("config_pending", "Changed configurations waiting to be written.", [&]() { return config.getPendingCount(); });
+    for (uint8_t i = 0; i < BootProfile::COUNT; i++) {
+        String labels = String(BootProfile::isMilestone(i) ? "milestone=\"" : "phase=\"") + BootProfile::getName(i) + "\"";
+        metrics.addGauge(BootProfile::isMilestone(i) ? "boot_milestone_seconds" : "boot_phase_seconds", BootProfile::isMilestone(i) ? "Time since power-on when the milestone was reached, 0 if not reached." : "Duration of the setup phase.", [&, i]() { return bootProfile.current.times_us[i] / 1000000.0; }, labels + ",boot=\"current\"");
+        metrics.addGauge(BootProfile::isMilestone(i) ? "boot_milestone_seconds" : "boot_phase_seconds", "", [&, i]() { return bootProfile.previous.times_us[i] / 1000000.0; }, labels + ",boot=\"previous\"");
+    }
+    metrics.addCounter("log_lines_total", "Log messages written.", [&]() { return logger.countLines(); });
+    metrics.addCounter("log_dropped_total", "Log messages lost because the output could not keep up.", [&]() { return logger.countDropped(); });
+    metrics.addCounter("log_syslog_datagrams_total", "Datagrams sent to the syslog server.", [&]() { return logger.logSyslog.countSent; });
+    metrics.addCounter("log_syslog_dropped_total", "Log messages not sent to the syslog server.", [&]() { return logger.logSyslog.countDropped; });
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////////
 
+void MVP3000::writeApiStatus(JsonWriter& json) {
+    json.beginObject();
+    json.writeUint("id", _helper.ESPX->getChipId());
+    json.writeText("build", __DATE__ " " __TIME__);
+    json.writeUint("uptime_ms", millis());
+    json.writeText("state", (state == STATE_TYPE::GOOD) ? "good" : (state == STATE_TYPE::INIT) ? "init" : "error");
+    json.writeText("resetReason", _helper.ESPX->getResetReason());
+    json.writeUint("cpuFreq_MHz", ESP.getCpuFreqMHz());
+    json.writeUint("heapFree", ESP.getFreeHeap());
+    json.writeUint("heapFragmentation", _helper.ESPX->getHeapFragmentation());
+    json.writeKey("loop_ms");
+    json.beginObject();
+    json.writeUint("mean", loopDurationMean_ms);
+    json.writeUint("min", (loopDurationMin_ms > loopDurationMax_ms) ? 0 : loopDurationMin_ms); // Not measured yet
+    json.writeUint("max", loopDurationMax_ms);
+    json.endObject();
+    json.writeKey("modules");
+    json.beginArray();
+    for (uint8_t i = 0; i < moduleCount; i++) {
+        json.beginObject();
+        json.writeText("name", xmodules[i]->description);
+        json.writeText("uri", xmodules[i]->uri);
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+}
+
 String MVP3000::templateProcessor(uint8_t var) {
     switch (var) {
         case 11:
             return __DATE__ " " __TIME__; // Timestamp concatenated at compilation time
         case 12:
-            return _helper.printFormatted("%d / %d", ESP.getFreeHeap(), _helper.ESPX->getHeapFragmentation());
+            {
+                StringBuffer<24> text;
+                text.appendUint(ESP.getFreeHeap()).append(" / ").appendUint(_helper.ESPX->getHeapFragmentation());
+                return text.c_str();
+            }
         case 13:
-            return String(_helper.millisToTime(millis()));
+            return _helper.millisToTime(millis());
         case 14:
             return _helper.ESPX->getResetReason();
         case 15:
             return String(ESP.getCpuFreqMHz());
         case 16:
-            return _helper.printFormatted("%d / %d / %d", loopDurationMean_ms, loopDurationMin_ms, loopDurationMax_ms);
+            {
+                StringBuffer<24> text;
+                text.appendUint(loopDurationMean_ms).append(" / ").appendUint(loopDurationMin_ms).append(" / ").appendUint(loopDurationMax_ms);
+                return text.c_str();
+            }
 
+        case 17:
+            if (!flightRecorder.previousValid)
+                return "no record, power-on";
+            {
+                StringBuffer<64> text;
+                text.append('#').appendUint(flightRecorder.previousBootCount).append(", ");
+                if (flightRecorder.previousState.phase == FlightRecorder::Phase::RESTART)
+                    text.append("restarted as intended");
+                else
+                    FlightRecorder::appendPhase(text.append("reset in phase "), flightRecorder.previousState);
+                return text.c_str();
+            }
         case 18:
             return (net.netCom.isHardDisabled()) ? "UDP discovery (disabled)" : "<a href='/netcom'>UDP discovery</a>";
 
-        case 20: // Not so long, could be one string
-            if (moduleCount == 0)
-                return "<li>None</li>";
-            webPageProcessorIndex = 0;
-        case 21:
-            // Note the ++ at the end
-            if ((xmodules[webPageProcessorIndex]->uri).length() > 0) {
-                return _helper.printFormatted("<li><a href='%s'>%s</a></li> %s", xmodules[webPageProcessorIndex]->uri.c_str(), xmodules[webPageProcessorIndex]->description.c_str(), (webPageProcessorIndex++ < moduleCount - 1) ? "%21%" : "");
-            } else {
-                return _helper.printFormatted("<li>%s</li> %s", xmodules[webPageProcessorIndex]->description.c_str(), (webPageProcessorIndex++ < moduleCount - 1) ? "%21%" : "");
+        default:
+            return "";
+    }
+}
+
+boolean MVP3000::templateListProcessor(uint8_t var, uint16_t index, String& row) {
+    switch (var) {
+        case 20: // Modules
+            if (moduleCount == 0) {
+                row = "<li>None</li>";
+                return (index == 0);
+            }
+            if (index >= moduleCount)
+                return false;
+            {
+                StringBuffer<128> line;
+                if ((xmodules[index]->uri).length() > 0)
+                    line.append("<li><a href='").append(xmodules[index]->uri).append("'>").append(xmodules[index]->description).append("</a></li> ");
+                else
+                    line.append("<li>").append(xmodules[index]->description).append("</li> ");
+                row = line.c_str();
             }
+            return true;
+
+        case 21: // Boot profile
+            if (index >= BootProfile::COUNT)
+                return false;
+            {
+                StringBuffer<64> line;
+                line.append("<li>").append(BootProfile::getName(index)).append(": ");
+                appendBootTime(line, bootProfile.current.times_us[index]);
+                line.append(" / ");
+                appendBootTime(line, bootProfile.previous.times_us[index]);
+                line.append("</li> ");
+                row = line.c_str();
+            }
+            return true;
+
+        case 22: // Flight recorder of the previous boot, oldest first
+            if (flightRecorder.previousEventCount == 0) {
+                row = "<li>No events</li>";
+                return (index == 0);
+            }
+            if (index >= flightRecorder.previousEventCount)
+                return false;
+            {
+                StringBuffer<96> line;
+                line.append("<li>");
+                FlightRecorder::appendEvent(line, flightRecorder.previousEvents[index]);
+                line.append("</li> ");
+                row = line.c_str();
+            }
+            return true;
 
         default:
-            return "";
+            return false;
+    }
+}
+
+void MVP3000::appendBootTime(StringBuilder& text, uint32_t time_us) {
+    if (time_us == 0) {
+        text.append('-');
+        return;
     }
+    // Milliseconds with one decimal
+    text.appendFixed((time_us + 50) / 100, 1);
 }
@@ -22,6 +22,9 @@ limitations under the License.
 #include "Logger.h"
 #include "Led.h"
 #include "Config.h"
+#include "Metrics.h"
+#include "MVP3000_BootProfile.h"
+#include "MVP3000_FlightRecorder.h"
 #include "Net.h"
 
 #include "_Xmodule.h"
@@ -61,6 +64,13 @@ class MVP3000 {
          */
         void udpHardDisable() { net.netCom.hardDisable(); };
 
+        /**
+         * @brief Store each configuration in its own JSON file instead of all in one binary bundle. Call before setup().
+         *
+         * Configurations stored in the bundle are not converted back.
+         */
+        void configJsonFiles() { config.format = Config::Format::JSON_FILES; };
+
     public:
 
         enum class STATE_TYPE: uint8_t {
@@ -74,6 +84,9 @@ class MVP3000 {
         // Helper helper;
         Led led;
         Logger logger;
+        Metrics metrics;
+        BootProfileStore bootProfile;
+        FlightRecorder flightRecorder;
         Net net;
 
         void setup();
@@ -92,6 +105,7 @@ class MVP3000 {
         void checkStatus();
 
         uint32_t delayedRestart_ms = 0;
+        boolean setupDone = false; // Including the network stages run from loop()
 
         uint32_t loopLast_ms = 0;
         uint16_t loopDurationMean_ms = 0;
@@ -99,11 +113,21 @@ class MVP3000 {
         uint16_t loopDurationMin_ms = std::numeric_limits<uint16_t>::max();
         void updateLoopDuration();
 
+        // Metrics, the loop duration is measured in micro seconds for the histogram
+        uint32_t loopLast_us = 0;
+        const float loopBounds_ms[7] = { 1, 2, 5, 10, 20, 50, 100 };
+        MetricHistogram loopHistogram = MetricHistogram(loopBounds_ms, 7);
+        uint32_t heapFreeMin = std::numeric_limits<uint32_t>::max(); // Low-water mark of the free heap
+        void registerMetrics();
+
 
     public:
 
+        void writeApiStatus(JsonWriter& json);
+
         String templateProcessor(uint8_t var);
-        uint8_t webPageProcessorIndex;
+        boolean templateListProcessor(uint8_t var, uint16_t index, String& row);
+        void appendBootTime(StringBuilder& text, uint32_t time_us);
         const char* webPage = R"===(
 <h3>System</h3> <ul>
 <li>ID: %1%</li>
@@ -112,9 +136,16 @@ class MVP3000 {
 <li>Uptime: %13%</li>
 <li>Last restart reason: %14%</li>
 <li>CPU frequency: %15% MHz</li>
-<li>Main loop duration: %16% ms (mean/min/max)</li> </ul>
+<li>Main loop duration: %16% ms (mean/min/max)</li>
+<li>Web page render time: %4% &micro;s (last home/module page)</li> </ul>
 <h3>Modules</h3>
 <ul> %20% </ul>
+<h3>Boot Profile</h3> <ul>
+<li>This boot / previous boot in ms, setup phases as duration, milestones since power-on:</li>
+%21% </ul>
+<h3>Flight Recorder</h3> <ul>
+<li>Previous boot: %17%</li>
+%22% </ul>
 <h3>Maintenance</h3> <ul>
 <li> <form action='/start' method='post' onsubmit='return confirm(`Restart?`);'> <input name='restart' type='hidden'> <input type='submit' value='Restart' > </form> </li>
 <li> <form action='/checkstart' method='post' onsubmit='return promptId(this);'> <input name='reset' type='hidden'> <input name='deviceId' type='hidden'> <input type='submit' value='Factory reset'> <input type='checkbox' name='keepwifi' checked value='1'> keep Wifi </form> </li> </ul>
@@ -0,0 +1,138 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MVP3000_BOOTPROFILE
+#define MVP3000_BOOTPROFILE
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "Config_JsonInterface.h"
+
+
+/**
+ * @brief Timings of a single boot in micro seconds.
+ *
+ * The setup phases are durations, measured one after the other. The milestones are the time since power-on.
+ * Zero means not (yet) reached.
+ */
+struct BootProfile {
+    enum Phase: uint8_t {
+        // Setup phases
+        LOGGER = 0,
+        CONFIG = 1, // Mount file system, read bundle and boot profile
+        LED = 2,
+        NET_CONFIG = 3,
+        WIFI_START = 4,
+        NET_WEB = 5,
+        NET_COM = 6,
+        NET_MQTT = 7,
+        MODULES = 8,
+        // Milestones
+        SETUP_DONE = 9, // Including the network stages run from the loop
+        WIFI_CONNECTED = 10,
+        FIRST_SAMPLE = 11,
+        FIRST_PUBLISH = 12,
+        COUNT = 13
+    };
+
+    uint32_t times_us[Phase::COUNT] = { };
+
+    static boolean isMilestone(uint8_t phase) { return phase >= Phase::SETUP_DONE; }
+
+    static const char* getName(uint8_t phase) {
+        static const char* names[Phase::COUNT] = { "logger", "config", "led", "net_config", "wifi_start", "net_web", "net_com", "net_mqtt", "modules", "setup_done", "wifi_connected", "first_sample", "first_publish" };
+        return names[phase];
+    }
+};
+
+
+/**
+ * @brief Profile of the current boot and of the previous one, stored as configuration.
+ *
+ * The current profile is exported, the previous one imported. It is saved once the first message is published, or after a timeout.
+ */
+struct BootProfileStore : public JsonInterface {
+    BootProfile current;
+    BootProfile previous;
+
+    boolean saved = false;
+    uint32_t saveTimeout_ms = 60000; // Devices without MQTT never publish
+
+    BootProfileStore() : JsonInterface("cfgBootProfile") { }
+
+    /**
+     * @brief Start measuring a setup phase, phases that follow each other directly need only one start.
+     */
+    void start() { lastMark_us = micros(); }
+
+    /**
+     * @brief End a setup phase, the next phase starts now.
+     */
+    void mark(uint8_t phase) {
+        uint32_t now_us = micros();
+        current.times_us[phase] = now_us - lastMark_us;
+        lastMark_us = now_us;
+    }
+
+    /**
+     * @brief Record a milestone, only the first call counts.
+     */
+    void milestone(uint8_t phase) {
+        if (current.times_us[phase] == 0)
+            current.times_us[phase] = micros();
+    }
+
+    boolean isSaveDue() {
+        return !saved && ((current.times_us[BootProfile::FIRST_PUBLISH] != 0) || (millis() > saveTimeout_ms));
+    }
+
+    void exportToJson(JsonDocument &jsonDoc) {
+        JsonArray jsonArray = jsonDoc.createNestedArray("us");
+        for (uint8_t i = 0; i < BootProfile::COUNT; i++)
+            jsonArray.add(current.times_us[i]);
+    }
+
+    bool importFromJson(JsonDocument &jsonDoc) {
+        if (!jsonDoc.containsKey("us") || !jsonDoc["us"].is<JsonArray>())
+            return false;
+        JsonArray jsonArray = jsonDoc["us"].as<JsonArray>();
+        if (jsonArray.size() != BootProfile::COUNT)
+            return false;
+        for (uint8_t i = 0; i < BootProfile::COUNT; i++)
+            previous.times_us[i] = jsonArray[i].as<uint32_t>();
+        return true;
+    }
+
+    void exportToBinary(TlvWriter &tlv) {
+        tlv.writeInt32Array(_helper.hashStringDjb2("us"), (const int32_t*)current.times_us, BootProfile::COUNT);
+    }
+
+    bool importFromBinary(TlvReader &tlv) {
+        bool success = false;
+        while (tlv.next()) {
+            if ((tlv.key == _helper.hashStringDjb2("us")) && (tlv.type == TLV_INT32_ARRAY))
+                success = tlv.asArray(previous.times_us, BootProfile::COUNT);
+        }
+        return success && !tlv.error;
+    }
+
+    private:
+
+        uint32_t lastMark_us = 0;
+};
+
+#endif
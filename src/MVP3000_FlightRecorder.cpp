@@ -0,0 +1,206 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "MVP3000_FlightRecorder.h"
+
+#include "MVP3000.h"
+extern MVP3000 mvp;
+
+#include "_Helper.h"
+extern _Helper _helper;
+
+
+#if defined(ESP8266)
+    // Block offset in the RTC user memory, the first 128 bytes are used by OTA updates
+    const uint8_t rtcMemoryStart = 32;
+#else
+    // Keeps its content on reset, random after power-on
+    RTC_NOINIT_ATTR uint32_t flightRecorderMemory[(sizeof(FlightRecorder::Header) + sizeof(FlightRecorder::State) + FlightRecorder::EVENT_COUNT * sizeof(FlightRecorder::Event)) / 4];
+#endif
+
+
+void FlightRecorder::begin() {
+    // Take over the previous record if the header is intact
+    Header previous;
+    load(headerOffset, &previous, sizeof(Header));
+    previousValid = (previous.magic == magic) && (previous.check == checksum(&previous, sizeof(Header) - 1)) && (previous.next < EVENT_COUNT);
+    if (previousValid) {
+        previousBootCount = previous.bootCount;
+        load(stateOffset, &previousState, sizeof(State));
+        if (previousState.check != checksum(&previousState, sizeof(State) - 1))
+            previousState.phase = Phase::PHASE_COUNT; // Unknown
+        // Oldest first, starting at the next slot that would have been written, events torn by the reset are skipped
+        previousEvents = new Event[EVENT_COUNT];
+        for (uint8_t i = 0; i < EVENT_COUNT; i++) {
+            Event& event = previousEvents[previousEventCount];
+            load(eventOffset + ((previous.next + i) % EVENT_COUNT) * sizeof(Event) / 4, &event, sizeof(Event));
+            if ((event.type != EventType::EMPTY) && (event.check == checksum(&event, sizeof(Event) - 1)))
+                previousEventCount++;
+        }
+    }
+
+    // Start a new record, the events are cleared only once here
+    Event empty = { };
+    for (uint8_t i = 0; i < EVENT_COUNT; i++)
+        store(eventOffset + i * sizeof(Event) / 4, &empty, sizeof(Event));
+    header = { magic, (uint16_t)(previousValid ? previous.bootCount + 1 : 0), 0, 0 };
+    header.check = checksum(&header, sizeof(Header) - 1);
+    store(headerOffset, &header, sizeof(Header));
+    phase(Phase::SETUP);
+    recording = true;
+}
+
+void FlightRecorder::dumpToLog() {
+    if (!previousValid)
+        return;
+
+    // The dump is not part of the new record
+    recording = false;
+    StringBuffer<48> lastPhase;
+    appendPhase(lastPhase, previousState);
+    if (previousState.phase == Phase::RESTART)
+        MVP3000_LOGF(SYSTEM, INFO, "Previous boot %u restarted as intended, %d events recorded.", previousBootCount, previousEventCount);
+    else
+        MVP3000_LOGF(SYSTEM, WARNING, "Previous boot %u reset in phase %s, %d events recorded.", previousBootCount, lastPhase.c_str(), previousEventCount);
+    for (uint8_t i = 0; i < previousEventCount; i++) {
+        StringBuffer<80> line;
+        appendEvent(line, previousEvents[i]);
+        MVP3000_LOG(SYSTEM, INFO, line.c_str());
+    }
+    recording = true;
+}
+
+void FlightRecorder::phase(Phase current, uint8_t module) {
+    // Duration of the phase that ends now
+    uint32_t now_us = micros();
+    if (now_us - phaseStart_us > slowestPhase_us) {
+        slowestPhase_us = now_us - phaseStart_us;
+        slowestPhase = state.phase;
+    }
+    phaseStart_us = now_us;
+
+    state = { (uint32_t)millis(), current, module, 0, 0 };
+    state.check = checksum(&state, sizeof(State) - 1);
+    store(stateOffset, &state, sizeof(State));
+}
+
+void FlightRecorder::startLoop() {
+    uint32_t now_ms = millis();
+    // Also ends the user phase of the previous loop
+    phase(Phase::CORE);
+
+    // Skip the first loop, nothing to measure
+    if (loopStart_ms > 0) {
+        uint32_t duration_ms = now_ms - loopStart_ms;
+        if (duration_ms >= slowLoop_ms)
+            record(EventType::SLOW_LOOP, slowestPhase, duration_ms);
+        if (duration_ms > intervalMax_ms) {
+            intervalMax_ms = duration_ms;
+            intervalMaxPhase = slowestPhase;
+        }
+    }
+    loopStart_ms = now_ms;
+    slowestPhase_us = 0;
+
+    heapFreeMin = min(heapFreeMin, ESP.getFreeHeap());
+    if (now_ms - intervalStart_ms >= interval_ms) {
+        intervalStart_ms = now_ms;
+        record(EventType::LOOP, intervalMaxPhase, intervalMax_ms);
+        record(EventType::HEAP, _helper.ESPX->getHeapFragmentation(), heapFreeMin);
+        intervalMax_ms = 0;
+        heapFreeMin = std::numeric_limits<uint32_t>::max();
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////
+
+void FlightRecorder::record(EventType type, uint8_t arg, uint32_t value, const char* text) {
+    if (!recording)
+        return;
+
+    Event event = { (uint32_t)millis(), value, type, arg, { }, 0 };
+    if (text != nullptr)
+        strncpy(event.text, text, sizeof(event.text) - 1);
+    event.check = checksum(&event, sizeof(Event) - 1);
+    store(eventOffset + header.next * sizeof(Event) / 4, &event, sizeof(Event));
+
+    // The header follows the event, a reset in between loses only the new event
+    header.next = (header.next + 1) % EVENT_COUNT;
+    header.check = checksum(&header, sizeof(Header) - 1);
+    store(headerOffset, &header, sizeof(Header));
+}
+
+uint8_t FlightRecorder::checksum(const void* data, uint8_t length) {
+    // Rotate and xor, the start value makes cleared memory invalid
+    uint8_t check = 0x5A;
+    for (uint8_t i = 0; i < length; i++)
+        check = ((check << 1) | (check >> 7)) ^ ((const uint8_t*)data)[i];
+    return check;
+}
+
+void FlightRecorder::store(uint16_t offset, const void* data, uint8_t length) {
+#if defined(ESP8266)
+    ESP.rtcUserMemoryWrite(rtcMemoryStart + offset, (uint32_t*)data, length);
+#else
+    memcpy(&flightRecorderMemory[offset], data, length);
+#endif
+}
+
+void FlightRecorder::load(uint16_t offset, void* data, uint8_t length) {
+#if defined(ESP8266)
+    ESP.rtcUserMemoryRead(rtcMemoryStart + offset, (uint32_t*)data, length);
+#else
+    memcpy(data, &flightRecorderMemory[offset], length);
+#endif
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////
+
+const char* FlightRecorder::getPhaseName(uint8_t phase) {
+    static const char* names[Phase::PHASE_COUNT] = { "setup", "core", "logger", "config", "led", "net", "net_mqtt", "net_com", "net_web", "module", "user", "restart" };
+    return (phase < Phase::PHASE_COUNT) ? names[phase] : "unknown";
+}
+
+void FlightRecorder::appendPhase(StringBuilder& text, const State& state) {
+    text.append(getPhaseName(state.phase));
+    if (state.phase == Phase::MODULE)
+        text.append(' ').appendUint(state.module);
+    if (state.phase < Phase::PHASE_COUNT)
+        text.append(" since ").appendTime(state.time_ms);
+}
+
+void FlightRecorder::appendEvent(StringBuilder& text, const Event& event) {
+    text.appendTime(event.time_ms).append(' ');
+    switch (event.type) {
+        case EventType::LOG: {
+            const char* levels = "EWUCDI"; // Same as the serial output
+            text.append("log [").append((event.arg < 6) ? levels[event.arg] : '?').append("] #").appendUint(event.value).append(' ').append(event.text);
+            break;
+        }
+        case EventType::SLOW_LOOP:
+            text.append("slow loop ").appendUint(event.value).append(" ms, longest phase ").append(getPhaseName(event.arg));
+            break;
+        case EventType::LOOP:
+            text.append("longest loop ").appendUint(event.value).append(" ms, longest phase ").append(getPhaseName(event.arg));
+            break;
+        case EventType::HEAP:
+            text.append("heap low-water ").appendUint(event.value).append(" bytes, ").appendUint(event.arg).append("% fragmented");
+            break;
+    }
+}
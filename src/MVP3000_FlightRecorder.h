@@ -0,0 +1,158 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef MVP3000_FLIGHTRECORDER
+#define MVP3000_FLIGHTRECORDER
+
+#include <Arduino.h>
+
+#include "_Helper_StringBuilder.h"
+
+
+/**
+ * @brief Keeps the last events before a reset in memory that survives soft and watchdog resets.
+ *
+ * ESP8266 uses the RTC user memory, ESP32 a no-init buffer in RTC memory. The header, the loop state, and every event carry their own checksum, so an interrupted write is detected and a single event costs the same no matter how many are stored.
+ * At boot the record of the previous boot is copied to RAM for the log and the web page, then recording starts anew.
+ */
+struct FlightRecorder {
+
+    enum EventType: uint8_t {
+        EMPTY = 0,
+        LOG = 1, // Log message, arg is the level, value the event id
+        SLOW_LOOP = 2, // Single loop above the threshold, arg is the slowest phase, value the duration in ms
+        LOOP = 3, // Longest loop of the interval, arg is the slowest phase, value the duration in ms
+        HEAP = 4, // Low-water mark of the interval, arg is the fragmentation in percent, value the free bytes
+    };
+
+    // Part of the main loop that is running, stored on every change
+    enum Phase: uint8_t {
+        SETUP = 0,
+        CORE = 1, // Status checks at the start of the loop
+        LOGGER = 2,
+        CONFIG = 3,
+        LED = 4,
+        NET = 5, // Setup stages and captive portal
+        NET_MQTT = 6,
+        NET_COM = 7,
+        NET_WEB = 8,
+        MODULE = 9, // Module index is stored in addition
+        USER = 10, // User code between the calls of mvp.loop()
+        RESTART = 11, // Intended restart
+        PHASE_COUNT = 12
+    };
+
+    struct Event {
+        uint32_t time_ms;
+        uint32_t value;
+        uint8_t type;
+        uint8_t arg;
+        char text[13]; // Log: start of the message
+        uint8_t check;
+    };
+
+    struct State {
+        uint32_t time_ms; // Start of the phase
+        uint8_t phase;
+        uint8_t module;
+        uint8_t spare;
+        uint8_t check;
+    };
+
+#if defined(ESP8266)
+    static const uint8_t EVENT_COUNT = 15; // 384 bytes of RTC user memory are free
+#else
+    static const uint8_t EVENT_COUNT = 64;
+#endif
+
+    uint32_t slowLoop_ms = 100; // Loops taking longer are recorded right away
+    uint32_t interval_ms = 60000; // Longest loop and heap low-water mark are recorded once per interval
+
+    // Record of the previous boot, oldest event first
+    boolean previousValid = false;
+    uint16_t previousBootCount = 0;
+    State previousState;
+    Event* previousEvents = nullptr;
+    uint8_t previousEventCount = 0;
+
+    ~FlightRecorder() { delete[] previousEvents; }
+
+    /**
+     * @brief Take over the record of the previous boot and start a new one. Call first in setup, the logger already records.
+     */
+    void begin();
+
+    // Write the record of the previous boot to the log
+    void dumpToLog();
+
+    // Errors, warnings, user and control messages, recorded before they are printed
+    void recordLog(uint8_t level, uint32_t eventId, const char* message) { record(EventType::LOG, level, eventId, message); }
+
+    /**
+     * @brief Mark the start of a loop phase, also measures the previous one.
+     *
+     * @param current The phase starting now.
+     * @param module (optional) Index of the module for the MODULE phase.
+     */
+    void phase(Phase current, uint8_t module = 0);
+
+    // Start of the main loop, evaluates the previous loop including the user code
+    void startLoop();
+
+    static const char* getPhaseName(uint8_t phase);
+    static void appendPhase(StringBuilder& text, const State& state);
+    static void appendEvent(StringBuilder& text, const Event& event);
+
+    struct Header {
+        uint32_t magic;
+        uint16_t bootCount;
+        uint8_t next; // Index of the next event to write
+        uint8_t check;
+    };
+
+    private:
+
+        const uint32_t magic = 0x4D565046; // MVPF
+
+        Header header = { };
+        State state = { };
+        boolean recording = false;
+
+        // Loop statistics
+        uint32_t loopStart_ms = 0;
+        uint32_t phaseStart_us = 0;
+        uint32_t slowestPhase_us = 0;
+        uint8_t slowestPhase = Phase::SETUP;
+        uint32_t intervalStart_ms = 0;
+        uint32_t intervalMax_ms = 0;
+        uint8_t intervalMaxPhase = Phase::SETUP;
+        uint32_t heapFreeMin = std::numeric_limits<uint32_t>::max();
+
+        void record(EventType type, uint8_t arg, uint32_t value, const char* text = nullptr);
+
+        static uint8_t checksum(const void* data, uint8_t length);
+
+        // Word offsets in the memory, each block a multiple of 4 bytes
+        const uint16_t headerOffset = 0;
+        const uint16_t stateOffset = sizeof(Header) / 4;
+        const uint16_t eventOffset = (sizeof(Header) + sizeof(State)) / 4;
+
+        void store(uint16_t offset, const void* data, uint8_t length);
+        void load(uint16_t offset, void* data, uint8_t length);
+};
+
+#endif
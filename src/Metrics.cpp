@@ -0,0 +1,86 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "Metrics.h"
+
+
+void Metrics::addCounter(const char* name, const char* help, std::function<uint32_t()> value, const String& labels) {
+    DataStructMetric* metric = new DataStructMetric(name, help, Type::COUNTER);
+    metric->counter = value;
+    metric->labels = labels;
+    linkedListMetrics.append(metric);
+}
+
+void Metrics::addGauge(const char* name, const char* help, std::function<float()> value, const String& labels) {
+    DataStructMetric* metric = new DataStructMetric(name, help, Type::GAUGE);
+    metric->gauge = value;
+    metric->labels = labels;
+    linkedListMetrics.append(metric);
+}
+
+void Metrics::addHistogram(const char* name, const char* help, MetricHistogram* histogram) {
+    DataStructMetric* metric = new DataStructMetric(name, help, Type::HISTOGRAM);
+    metric->histogram = histogram;
+    linkedListMetrics.append(metric);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////
+
+void Metrics::writePrometheus(Print& out) {
+    const char* previousName = "";
+    linkedListMetrics.loop([&](DataStructMetric*& metric, uint16_t i) {
+        // Header once per name, labeled metrics follow each other
+        if (strcmp(metric->name, previousName) != 0)
+            writeHeader(out, metric);
+        previousName = metric->name;
+        switch (metric->type) {
+            case Type::COUNTER:
+                writeName(out, metric);
+                out.printf(" %lu\n", (unsigned long)metric->counter());
+                break;
+            case Type::GAUGE:
+                writeName(out, metric);
+                out.printf(" %g\n", metric->gauge());
+                break;
+            case Type::HISTOGRAM: {
+                // Buckets are cumulative in the export
+                uint32_t cumulative = 0;
+                for (uint8_t b = 0; b < metric->histogram->boundCount; b++) {
+                    cumulative += metric->histogram->buckets[b];
+                    out.printf("mvp3000_%s_bucket{le=\"%g\"} %lu\n", metric->name, metric->histogram->bounds[b], (unsigned long)cumulative);
+                }
+                out.printf("mvp3000_%s_bucket{le=\"+Inf\"} %lu\n", metric->name, (unsigned long)metric->histogram->count);
+                out.printf("mvp3000_%s_sum %g\n", metric->name, metric->histogram->sum);
+                out.printf("mvp3000_%s_count %lu\n", metric->name, (unsigned long)metric->histogram->count);
+                break;
+            }
+        }
+    });
+}
+
+void Metrics::writeHeader(Print& out, DataStructMetric* metric) {
+    const char* typeName = (metric->type == Type::COUNTER) ? "counter" : (metric->type == Type::GAUGE) ? "gauge" : "histogram";
+    out.printf("# HELP mvp3000_%s %s\n", metric->name, metric->help);
+    out.printf("# TYPE mvp3000_%s %s\n", metric->name, typeName);
+}
+
+void Metrics::writeName(Print& out, DataStructMetric* metric) {
+    if (metric->labels.length() > 0)
+        out.printf("mvp3000_%s{%s}", metric->name, metric->labels.c_str());
+    else
+        out.printf("mvp3000_%s", metric->name);
+}
@@ -0,0 +1,135 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MVP3000_METRICS
+#define MVP3000_METRICS
+
+#include <Arduino.h>
+
+#include "_Helper_LinkedList.h"
+
+
+/**
+ * @brief Histogram with fixed bucket bounds, the counts are cumulative only on export.
+ *
+ * @param bounds Upper bounds of the buckets in increasing order, needs to stay valid. Values above the last bound are counted in +Inf.
+ * @param boundCount The number of bounds.
+ */
+struct MetricHistogram {
+    const float* bounds;
+    uint8_t boundCount;
+    uint32_t* buckets; // One per bound plus +Inf
+    uint32_t count = 0;
+    double sum = 0;
+
+    MetricHistogram(const float* bounds, uint8_t boundCount) : bounds(bounds), boundCount(boundCount) {
+        buckets = new uint32_t[boundCount + 1]();
+    }
+    ~MetricHistogram() { delete[] buckets; }
+
+    void observe(float value) {
+        uint8_t i = 0;
+        while ((i < boundCount) && (value > bounds[i]))
+            i++;
+        buckets[i]++;
+        count++;
+        sum += value;
+    }
+};
+
+
+/**
+ * @brief Registry of runtime metrics, exported in the Prometheus text format on /metrics.
+ *
+ * Subsystems register their existing counters and values as functions, the registry itself stores no values.
+ * Names are prefixed with mvp3000_, counters should end with _total. Metrics of the same name with different labels
+ * need to be registered one after the other.
+ */
+class Metrics {
+
+    public:
+
+        enum Type: uint8_t {
+            COUNTER = 0,
+            GAUGE = 1,
+            HISTOGRAM = 2
+        };
+
+        /**
+         * @brief Register a counter, a value that only increases.
+         *
+         * @param name The name of the metric, without prefix.
+         * @param help The description of the metric.
+         * @param value The function returning the current value.
+         * @param labels (optional) Labels of the metric, for example phase="wifi".
+         */
+        void addCounter(const char* name, const char* help, std::function<uint32_t()> value, const String& labels = "");
+
+        /**
+         * @brief Register a gauge, a value that goes up and down.
+         *
+         * @param name The name of the metric, without prefix.
+         * @param help The description of the metric.
+         * @param value The function returning the current value.
+         * @param labels (optional) Labels of the metric, for example phase="wifi".
+         */
+        void addGauge(const char* name, const char* help, std::function<float()> value, const String& labels = "");
+
+        /**
+         * @brief Register a histogram, the owner calls observe() on it.
+         *
+         * @param name The name of the metric, without prefix.
+         * @param help The description of the metric.
+         * @param histogram The histogram, needs to stay valid.
+         */
+        void addHistogram(const char* name, const char* help, MetricHistogram* histogram);
+
+        /**
+         * @brief Write all metrics in the Prometheus text exposition format.
+         *
+         * @param out The output to write to, typically the response stream of the web server.
+         */
+        void writePrometheus(Print& out);
+
+    private:
+
+        struct DataStructMetric {
+            const char* name;
+            const char* help;
+            String labels;
+            uint8_t type;
+            std::function<uint32_t()> counter;
+            std::function<float()> gauge;
+            MetricHistogram* histogram = nullptr;
+
+            DataStructMetric(const char* name, const char* help, uint8_t type) : name(name), help(help), type(type) { }
+        };
+
+        struct LinkedListMetrics : LinkedList3100<DataStructMetric> {
+            LinkedListMetrics() : LinkedList3100<DataStructMetric>() { }
+
+            void append(DataStructMetric* metric) {
+                this->appendDataStruct(metric);
+            }
+        };
+
+        LinkedListMetrics linkedListMetrics; // Adaptive size
+
+        void writeHeader(Print& out, DataStructMetric* metric);
+        void writeName(Print& out, DataStructMetric* metric);
+};
+
+#endif
@@ -21,37 +21,73 @@ extern MVP3000 mvp;
 
 
 void Net::setup() {
-    // Read config
-    mvp.config.readCfg(cfgNet);
-
-    // Start wifi
-    startWifi();
-
-    // Init web interface, UDP discovery and MQTT (in that order)
-    netWeb.setup();
-    netCom.setup();
-    netMqtt.setup();
-
-    // Register config
-    netWeb.registerCfg(&cfgNet);
-
-    // Register actions
-    netWeb.registerAction("setwifi", [&](int args, WebArgKeyValue argKey, WebArgKeyValue argValue) {
-        // argValue(0) is the action name
-        if (args != 3)
-            return false;
-        if ((argKey(1) != "newSsid") && (argKey(2) != "newPass"))
-            return false;
-        return editClientConnection(argValue(1), argValue(2));
-    }, "Connecting to network ...");
+    // Nothing blocking here, the modules already run while the network comes up stage by stage from loop()
+    setupStage = SETUP_STAGE::CONFIG;
+}
+
+void Net::setupNextStage() {
+    mvp.bootProfile.start();
+    switch (setupStage) {
+        case SETUP_STAGE::CONFIG:
+            mvp.config.readCfg(cfgNet);
+            // Register config
+            netWeb.registerCfg(&cfgNet);
+            // Register actions
+            netWeb.registerAction("setwifi", [&](int args, WebArgKeyValue argKey, WebArgKeyValue argValue) {
+                // argValue(0) is the action name
+                if (args != 3)
+                    return false;
+                if ((argKey(1) != "newSsid") && (argKey(2) != "newPass"))
+                    return false;
+                return editClientConnection(argValue(1), argValue(2));
+            }, "Connecting to network ...");
+            mvp.bootProfile.mark(BootProfile::NET_CONFIG);
+            setupStage = SETUP_STAGE::WIFI;
+            break;
+
+        case SETUP_STAGE::WIFI:
+            // Connecting continues in the background
+            startWifi();
+            mvp.bootProfile.mark(BootProfile::WIFI_START);
+            setupStage = SETUP_STAGE::WEB;
+            break;
+
+        // Web interface, UDP discovery and MQTT (in that order)
+        case SETUP_STAGE::WEB:
+            netWeb.setup();
+            mvp.bootProfile.mark(BootProfile::NET_WEB);
+            setupStage = SETUP_STAGE::COM;
+            break;
+
+        case SETUP_STAGE::COM:
+            netCom.setup();
+            mvp.bootProfile.mark(BootProfile::NET_COM);
+            setupStage = SETUP_STAGE::MQTT;
+            break;
+
+        case SETUP_STAGE::MQTT:
+            netMqtt.setup();
+            mvp.bootProfile.mark(BootProfile::NET_MQTT);
+            setupStage = SETUP_STAGE::DONE;
+            break;
 
+        default:
+            break;
+    }
 }
 
 void Net::loop() {
+    if (setupStage != SETUP_STAGE::DONE) {
+        setupNextStage();
+        return;
+    }
+
     switch (netState) {
         case NET_STATE_TYPE::CLIENT:
             // Communication only for client
+            mvp.flightRecorder.phase(FlightRecorder::Phase::NET_MQTT);
             netMqtt.loop();
+            mvp.flightRecorder.phase(FlightRecorder::Phase::NET_COM);
             netCom.loop();
             break;
         case NET_STATE_TYPE::AP:
@@ -65,6 +101,7 @@ void Net::loop() {
     }
 
     // Web interface for all
+    mvp.flightRecorder.phase(FlightRecorder::Phase::NET_WEB);
     netWeb.loop();
 
     // Check if delayed restart was set
@@ -91,7 +128,7 @@ bool Net::editClientConnection(const String& newSsid, const String& newPass) {
         clientConnectSuccess = false;
         // Restart wifi with new settings but leave time for web response to be sent
         delayedRestartWifi();
-        mvp.logger.write(CfgLogger::Level::INFO, "SSID and pass updated.");
+        MVP3000_LOG(NET, INFO, "SSID and pass updated.");
         return true;
     }
     return false;
@@ -125,20 +162,20 @@ void Net::startAp() {
     WiFi.mode(WIFI_AP);
     if (!WiFi.softAP(apSsid)) {
         netState = NET_STATE_TYPE::ERROR;
-        mvp.logger.write(CfgLogger::Level::ERROR, "Error starting AP.");
+        MVP3000_LOG(NET, ERROR, "Error starting AP.");
         return;
     }
 
     // Start captive portal
     if (!dnsServer.start(53, "*", WiFi.softAPIP())) {
         netState = NET_STATE_TYPE::ERROR;
-        mvp.logger.write(CfgLogger::Level::ERROR, "Error starting captive portal.");
+        MVP3000_LOG(NET, ERROR, "Error starting captive portal.");
         return;
     }
 
     netState = NET_STATE_TYPE::AP;
     myIp = WiFi.softAPIP();
-    mvp.logger.writeFormatted(CfgLogger::Level::INFO, "AP started: %s, %s", apSsid.c_str(), WiFi.softAPIP().toString().c_str());
+    MVP3000_LOGF(NET, INFO, "AP started: %s, %s", apSsid.c_str(), WiFi.softAPIP().toString().c_str());
 }
 
 
@@ -159,7 +196,8 @@ void Net::startClient() {
 
 void Net::connectClient() {
     WiFi.begin(cfgNet.clientSsid, cfgNet.clientPass);
-    mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Connecting to (SSID/pass): %s/%s", cfgNet.clientSsid.c_str(), cfgNet.clientPass.c_str());
+    // Never log the password, the log can leave the device
+    MVP3000_LOGF(NET, INFO, "Connecting to SSID: %s", cfgNet.clientSsid.c_str());
 }
 
 void Net::WiFiGotIP() { //
@@ -171,23 +209,41 @@ void Net::WiFiGotIP() { //
     // Reconnect endlessly to a previously successfully connected network (until reboot)
     clientConnectSuccess = true;
     myIp = WiFi.localIP();
-    mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Connection established: %s", WiFi.localIP().toString().c_str() );
+    mvp.bootProfile.milestone(BootProfile::WIFI_CONNECTED);
+    MVP3000_LOGF(NET, INFO, "Connection established: %s", WiFi.localIP().toString().c_str() );
 }
 
 void Net::WiFiStationDisconnected() {
     myIp = INADDR_NONE;
     netState = NET_STATE_TYPE::CONNECTING;
     if (clientConnectSuccess || cfgNet.forceClientMode) {
-        mvp.logger.write(CfgLogger::Level::INFO, "Network disconnected.");
+        MVP3000_LOG(NET, INFO, "Network disconnected.");
         connectClient();
     } else if (++clientConnectFails < cfgNet.clientConnectRetries) {
         connectClient();
     } else {
-        mvp.logger.write(CfgLogger::Level::INFO, "Client connect limit reached.");
+        MVP3000_LOG(NET, INFO, "Client connect limit reached.");
         startAp();
     }
 }
 
+void Net::writeApiStatus(JsonWriter& json) {
+    json.beginObject();
+    switch (netState) {
+        case NET_STATE_TYPE::CLIENT: json.writeText("state", "client"); break;
+        case NET_STATE_TYPE::CONNECTING: json.writeText("state", "connecting"); break;
+        case NET_STATE_TYPE::AP: json.writeText("state", "ap"); break;
+        case NET_STATE_TYPE::DISABLEDX: json.writeText("state", "disabled"); break;
+        default: json.writeText("state", "error"); break;
+    }
+    json.writeText("ip", myIp.toString());
+    json.writeText("ssid", (netState == NET_STATE_TYPE::AP) ? apSsid : cfgNet.clientSsid);
+    if (netState == NET_STATE_TYPE::CLIENT)
+        json.writeInt("rssi_dBm", WiFi.RSSI());
+    json.writeBool("udpDiscovery", !netCom.isHardDisabled());
+    json.endObject();
+}
+
 String Net::templateProcessor(uint8_t var) {
     switch (var) {
         case 41:
@@ -51,7 +51,7 @@ struct CfgNet : public CfgJsonInterface  {
     CfgNet() : CfgJsonInterface("cfgNet") {
         addSetting<uint16_t>("clientConnectRetries", &clientConnectRetries, [](uint16_t x) { return (x > 100) ? false : true; }); // Limit to 100, any more is 'forever'
         addSetting<String>("clientSsid", &clientSsid, [](const String& x) { return true; } ); // Check is in extra function
-        addSetting<String>("clientPass", &clientPass, [](const String& x) { return true; }); // Check is in extra function
+        addSetting<String>("clientPass", &clientPass, [](const String& x) { return true; }, true); // Check is in extra function, secret
         addSetting<boolean>("forceClientMode", &forceClientMode, [](boolean _) { return true; });
     }
 };
@@ -82,6 +82,18 @@ class Net {
         void setup();
         void loop();
 
+        // The network comes up in stages from loop(), one stage per loop
+        enum class SETUP_STAGE: uint8_t {
+            CONFIG = 0,
+            WIFI = 1,
+            WEB = 2,
+            COM = 3,
+            MQTT = 4,
+            DONE = 5
+        };
+        SETUP_STAGE setupStage = SETUP_STAGE::CONFIG;
+        boolean isSetupDone() { return (setupStage == SETUP_STAGE::DONE); }
+
         bool editClientConnection(const String& newSsid, const String& newPass);
         void cleanCfgKeepClientInfo();
 
@@ -90,6 +102,8 @@ class Net {
     private:                                        // TODO clean up
         DNSServer dnsServer;
 
+        void setupNextStage();
+
         // Counter for client connect fails
         uint8_t clientConnectFails = 0;
         boolean clientConnectSuccess = false;
@@ -112,6 +126,8 @@ class Net {
 
     public:
 
+        void writeApiStatus(JsonWriter& json);
+
         String templateProcessor(uint8_t var);
         const char* webPage = R"===(
 <h3>Network</h3> <ul>
@@ -90,7 +90,7 @@ void NetCom::sendDiscovery() {
     }
 
     udpSendMessage("MVP3000", WiFi.broadcastIP());
-    mvp.logger.write(CfgLogger::Level::INFO, "Discovery request sent.");
+    MVP3000_LOG(NET, INFO, "Discovery request sent.");
 }
 
 void NetCom::udpReceiveMessage() {
@@ -109,7 +109,7 @@ void NetCom::udpReceiveMessage() {
     // Check for MVP3000, respond with DEVICE[ID]
     if (strncmp(packetBuffer, "MVP3000", 7) == 0) {
         udpSendMessage((String("DEVICE") + String(_helper.ESPX->getChipId())).c_str() , udp.remoteIP());
-        mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Discovery response sent to: %s", udp.remoteIP().toString().c_str());
+        MVP3000_LOGF(NET, INFO, "Discovery response sent to: %s", udp.remoteIP().toString().c_str());
         return;
     }
     // Check for SERVER, store the IP and the SKILL string
@@ -117,7 +117,7 @@ void NetCom::udpReceiveMessage() {
         serverIp = udp.remoteIP();
         serverSkills = packetBuffer + 7;
         lastDiscovery = millis();
-        mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Server response: %s from %s", serverSkills.c_str(), serverIp.toString().c_str());
+        MVP3000_LOGF(NET, INFO, "Server response: %s from %s", serverSkills.c_str(), serverIp.toString().c_str());
         return;
     }
 }
@@ -126,19 +126,19 @@ void NetCom::udpSendMessage(const char* message, IPAddress remoteIp) {
     // Test this using netcat: nc -ul [laptopIP] [port]
 
     if (!cfgNetCom.udpEnabled) {
-        mvp.logger.write(CfgLogger::Level::WARNING, "UDP disabled.");
+        MVP3000_LOG(NET, WARNING, "UDP disabled.");
         return;
     }
     // Send UDP packet
     if (!udp.beginPacket(remoteIp, cfgNetCom.discoveryPort)) {
-        mvp.logger.write(CfgLogger::Level::WARNING, "UDP not sent, send error.");
+        MVP3000_LOG(NET, WARNING, "UDP not sent, send error.");
         return;
     }
     for (uint16_t i = 0; i < strlen(message); i++) {
         udp.write((uint8_t)message[i]);
     }
     if (!udp.endPacket()) {
-        mvp.logger.write(CfgLogger::Level::WARNING, "UDP not completed, send error.");
+        MVP3000_LOG(NET, WARNING, "UDP not completed, send error.");
     }
 }
 
@@ -160,7 +160,13 @@ String NetCom::templateProcessor(uint8_t var) {
         case 52:
             return String(cfgNetCom.discoveryPort);
         case 53:
-            return (serverIp == INADDR_NONE) ? "none" : _helper.printFormatted("%s: %s", serverIp.toString().c_str(), serverSkills.c_str());
+            if (serverIp == INADDR_NONE)
+                return "none";
+            {
+                StringBuffer<96> text;
+                text.append(serverIp.toString()).append(": ").append(serverSkills);
+                return text.c_str();
+            }
 
         default:
             return "";
@@ -37,14 +37,32 @@ extern MVP3000 mvp;
 void NetMqtt::setup() {
     // Read config and register with web interface
     mvp.config.readCfg(cfgNetMqtt);
+    publishQueue.setMaxSize(cfgNetMqtt.publishQueueSize);
+    publishQueue.dropPolicy = cfgNetMqtt.publishDropPolicy;
+    inFlight.setWindow(cfgNetMqtt.inFlightWindow);
     setMqttState();
 
     // Redefine needed with network, otherwise mqttClient.connected() crashes
     mqttClient = MqttClient(wifiClient);
 
+    // QoS 1 acknowledgements are picked up from the received data, the library only consumes them
+    wifiClient.onPubAck = [&](uint16_t packetId) {
+        if (inFlight.acknowledge(packetId))
+            publishQueue.countSent++;
+    };
+
     // Register config
     mvp.net.netWeb.registerCfg(&cfgNetMqtt, std::bind(&NetMqtt::saveCfgCallback, this));
 
+    // Register metrics
+    mvp.metrics.addGauge("mqtt_connected", "Connected to the broker.", [&]() { return (mqttState == MQTT_STATE::CONNECTED) ? 1 : 0; });
+    mvp.metrics.addCounter("mqtt_enqueued_total", "Messages added to the publish queue.", [&]() { return publishQueue.countEnqueued; });
+    mvp.metrics.addCounter("mqtt_sent_total", "Messages sent, with QoS 1 acknowledged.", [&]() { return publishQueue.countSent; });
+    mvp.metrics.addCounter("mqtt_dropped_total", "Messages dropped from the publish queue.", [&]() { return publishQueue.countDropped; });
+    mvp.metrics.addCounter("mqtt_retransmitted_total", "QoS 1 messages sent again.", [&]() { return inFlight.countRetransmit; });
+    mvp.metrics.addGauge("mqtt_queue_depth", "Messages waiting in the publish queue.", [&]() { return publishQueue.getSize(); });
+    mvp.metrics.addGauge("mqtt_inflight", "QoS 1 messages waiting for acknowledgement.", [&]() { return inFlight.getSize(); });
+
     // For some reason the mqttClient.onMessage() method does not work when the function is in a class ...
     // mqttClient.onMessage(handleMessage); // argument of type "void (NetMqtt::*)(int messageSize)" is incompatible with parameter of type "void (*)(int)"
     // mqttClient.onMessage([] (int messageSize) { handleMessage; }); // invalid use of non-static member function 'void NetMqtt::handleMessage(int)'
@@ -72,14 +90,16 @@ void NetMqtt::loop() {
             // Check state change
             if (mqttClient.connected()) {
                 mqttState = MQTT_STATE::CONNECTED;
-                mvp.logger.write(CfgLogger::Level::INFO, "Connected to MQTT broker, subscribing to topics.");
+                MVP3000_LOG(MQTT, INFO, "Connected to MQTT broker, subscribing to topics.");
                 // Subscribe to all topics with a callback
                 linkedListMqttTopic.loop([&](DataStructMqttTopic* current, uint16_t i) {
                     // Only subscribe if there is a callback
                     if (current->ctrlCallback != nullptr) {
-                        mqttClient.subscribe(current->getCtrlTopic());
+                        mqttClient.subscribe(current->getCtrlTopic(), cfgNetMqtt.mqttQos);
                     }
                 });
+                // Messages not acknowledged before the connection was lost need to be sent again, from the following loops
+                inFlight.resendAll();
                 break;
             }
 
@@ -91,7 +111,7 @@ void NetMqtt::loop() {
             // Check state change
             if (!mqttClient.connected()) {
                 setMqttState();
-                mvp.logger.write(CfgLogger::Level::WARNING, "Disconnected from MQTT broker.");
+                MVP3000_LOG(MQTT, WARNING, "Disconnected from MQTT broker.");
                 break;
             }
 
@@ -101,6 +121,15 @@ void NetMqtt::loop() {
             if (messageSize > 0) {
                 handleMessage(messageSize);
             }
+
+            // Send what the modules have queued since the last loop
+            retransmitInFlight();
+            publishQueued();
+
+            if (throughputTimer.justFinished()) {
+                sentPerSecond = publishQueue.countSent - sentLastSecond;
+                sentLastSecond = publishQueue.countSent;
+            }
             break;
 
         case MQTT_STATE::DISCONNECTED: // We have given up, do we want this ??? sometimes yes, external server is down maybe? but then again, if we want MQTT we should never give up?
@@ -114,9 +143,13 @@ void NetMqtt::loop() {
 
 ///////////////////////////////////////////////////////////////////////////////////
 
-std::function<void(const String &message)> NetMqtt::registerMqtt(const String& baseTopic, MqttCtrlCallback ctrlCallback) {
+MqttPrint NetMqtt::registerMqtt(const String& baseTopic, MqttCtrlCallback ctrlCallback) {
     // Store topic and callback for registering with MQTT, return the function to write to this topic
-    return linkedListMqttTopic.appendUnique(&mqttClient, baseTopic, ctrlCallback);
+    MqttPrint mqttPrint = linkedListMqttTopic.appendUnique(&publishQueue, baseTopic, ctrlCallback);
+    // Received topics are compared in full, also when a module registers a long base topic
+    if (ctrlCallback != nullptr)
+        wifiClient.reserveTopic(linkedListMqttTopic.tail->dataStruct->getCtrlTopic().length());
+    return mqttPrint;
 }
 
 void NetMqtt::setMqttState() {
@@ -128,13 +161,23 @@ void NetMqtt::setMqttState() {
         mqttState = MQTT_STATE::NOBROKER;
     }
     connectTimer.restart();
+
+    // Keep queueing while (re-)connecting, messages are sent once connected
+    publishQueue.accepting = (mqttState == MQTT_STATE::CONNECTING);
+    if (!publishQueue.accepting) {
+        publishQueue.clear();
+        inFlight.clear();
+    }
 }
 
 void NetMqtt::connectMqtt() {
     // Reconnect tries are gone, remove local broker as it did not work
     if (connectTimer.plusOne()) {
         mqttState = MQTT_STATE::DISCONNECTED;
-        mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Connecting to MQTT broker failed, giving up.");
+        publishQueue.accepting = false;
+        publishQueue.clear();
+        inFlight.clear();
+        MVP3000_LOGF(MQTT, INFO, "Connecting to MQTT broker failed, giving up.");
         return;
     }
 
@@ -142,10 +185,13 @@ void NetMqtt::connectMqtt() {
     if (!connectTimer.justFinished())
         return;
 
+    // New connection, the previous one may have ended within a packet
+    wifiClient.resetParser();
+
     if (cfgNetMqtt.mqttForcedBroker.length() > 0) {
         // Connect to forced broker
         mqttClient.connect(cfgNetMqtt.mqttForcedBroker.c_str(), cfgNetMqtt.mqttPort);
-        mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Connecting to remote MQTT broker: %s", cfgNetMqtt.mqttForcedBroker.c_str());
+        MVP3000_LOGF(MQTT, INFO, "Connecting to remote MQTT broker: %s", cfgNetMqtt.mqttForcedBroker.c_str());
     } else {
         // Update local broker, it could have changed since it was originally queried
         localBrokerIp = mvp.net.netCom.checkSkill("MQTT");
@@ -155,30 +201,113 @@ void NetMqtt::connectMqtt() {
         }
         // The library is broken for ESP8266, it does not accept the IPAddress-type when a port is given
         mqttClient.connect(localBrokerIp.toString().c_str(), cfgNetMqtt.mqttPort);
-        mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Connecting to local MQTT broker: %s", localBrokerIp.toString().c_str());
+        MVP3000_LOGF(MQTT, INFO, "Connecting to local MQTT broker: %s", localBrokerIp.toString().c_str());
+    }
+}
+
+boolean NetMqtt::canWrite(size_t length, const String& topic) {
+#ifdef ESP8266
+    // Do not block the loop on a congested connection, the message waits for the next loop
+    // Wait until the whole message fits into the TCP send buffer, or at least 1 kB for messages larger than the buffer itself
+    // Overhead: fixed header 1 byte, remaining length up to 4 bytes, topic length 2 bytes, packet id 2 bytes
+    size_t required = length + topic.length() + 9;
+    return (size_t)wifiClient.availableForWrite() >= min(required, (size_t)1024);
+#else
+    return true;
+#endif
+}
+
+void NetMqtt::publishQueued() {
+    // Send queued messages until the queue is empty or the time budget of this loop is used up
+    uint32_t start_ms = millis();
+    while (publishQueue.getSize() > 0) {
+        MqttMessageSlot* queued = publishQueue.getOldest();
+        const String& topic = queued->mqttTopic->getDataTopic();
+
+        if (!canWrite(queued->length, topic))
+            break;
+
+        if (cfgNetMqtt.mqttQos == 1) {
+            // Wait for acknowledgements if the window is used up
+            if (inFlight.isFull())
+                break;
+            // Counted as sent when acknowledged
+            MqttInFlightSlot* sent = inFlight.append(queued);
+            if (!wifiClient.writePublishQos1(topic.c_str(), (const uint8_t*)sent->data, sent->length, sent->packetId, false)) {
+                // Not in flight, the message stays queued for the next connection
+                inFlight.acknowledge(sent->packetId);
+                writeFailed();
+                break;
+            }
+            publishQueue.removeOldest();
+        } else {
+            // With the size known in advance the library streams the message instead of buffering it
+            mqttClient.beginMessage(topic.c_str(), (unsigned long)queued->length);
+            mqttClient.write((const uint8_t*)queued->data, queued->length);
+            mqttClient.endMessage();
+            publishQueue.removeSent();
+        }
+        mvp.bootProfile.milestone(BootProfile::FIRST_PUBLISH);
+
+        if (millis() - start_ms >= cfgNetMqtt.publishTimeBudget)
+            break;
     }
 }
 
+void NetMqtt::retransmitInFlight() {
+    // Send unacknowledged QoS 1 messages again, those not yet sent on this connection and those that timed out
+    // Within the same limits as new messages, a full window after a reconnect is spread over several loops
+    uint32_t start_ms = millis();
+    boolean stop = false;
+    inFlight.loop([&](MqttInFlightSlot* current) {
+        if (stop || (!current->resend && (millis() - current->sent_ms < inFlightTimeout_ms)))
+            return;
+        const String& topic = current->mqttTopic->getDataTopic();
+        if (!canWrite(current->length, topic)) {
+            stop = true;
+            return;
+        }
+        if (!wifiClient.writePublishQos1(topic.c_str(), (const uint8_t*)current->data, current->length, current->packetId, true)) {
+            writeFailed();
+            stop = true;
+            return;
+        }
+        current->resend = false;
+        current->sent_ms = millis();
+        inFlight.countRetransmit++;
+        if (millis() - start_ms >= cfgNetMqtt.publishTimeBudget)
+            stop = true;
+    });
+}
+
+void NetMqtt::writeFailed() {
+    // Part of the packet may have been written, the broker cannot parse what follows, start over with a new connection
+    MVP3000_LOG(MQTT, WARNING, "MQTT write failed, reconnecting.");
+    wifiClient.stop();
+}
+
 void NetMqtt::handleMessage(int messageSize) {
-    // Check if message is a duplicate, requires QoS 1+ and needs to be implemented by the sender and the receiver
-    if (mqttClient.messageDup())
-        return; // Handling of duplicates not implemented
+    // Drop a retransmitted QoS 1 message that was already handled, the broker sends it again if our acknowledgement got lost
+    if ((mqttClient.messageQoS() > 0) && recentPacketIds.isDuplicate(wifiClient.lastPublishPacketId, mqttClient.messageDup())) {
+        MVP3000_LOGF(MQTT, CONTROL, "MQTT duplicate message %d dropped.", wifiClient.lastPublishPacketId);
+        return;
+    }
 
-    String topic = mqttClient.messageTopic();
-    // Topic is prefixed with the device ID and suffixed with _ctrl, we only need the base topic
-    topic = topic.substring(topic.indexOf('_') + 1, topic.lastIndexOf('_'));
+    // The topic was picked up from the received data, the library would return a copy
+    const char* topic = wifiClient.getLastPublishTopic();
 
-    // Copy message to buffer, needs to be done after reading the topic as it clears the message-ready flag
+    // Copy message to buffer
     uint8_t buf[messageSize + 1];
     mqttClient.read(buf, messageSize + 1);
     buf[messageSize] = '\0';
 
     // Find the topic in the list and execute callback
-    DataStructMqttTopic *mqttTopic = linkedListMqttTopic.findTopic(topic);
+    // A topic longer than all subscribed ones was cut and only matches by accident
+    DataStructMqttTopic *mqttTopic = wifiClient.isTopicTruncated() ? nullptr : linkedListMqttTopic.findByCtrlTopic(topic);
     if ((mqttTopic != nullptr) && (mqttTopic->ctrlCallback != nullptr)) {
         mqttTopic->ctrlCallback((char *)buf);
     } else {
-        mvp.logger.writeFormatted(CfgLogger::Level::CONTROL, "MQTT control with unknown topic '%s'", topic.c_str());
+        MVP3000_LOGF(MQTT, CONTROL, "MQTT control with unknown topic '%s%s'", topic, wifiClient.isTopicTruncated() ? "..." : "");
     }
 }
 
@@ -186,11 +315,46 @@ void NetMqtt::handleMessage(int messageSize) {
 ///////////////////////////////////////////////////////////////////////////////////
 
 void NetMqtt::saveCfgCallback() {
-    mvp.logger.write(CfgLogger::Level::INFO, "MQTT configuration changed, restarting MQTT client.");
+    MVP3000_LOG(MQTT, INFO, "MQTT configuration changed, restarting MQTT client.");
+    publishQueue.setMaxSize(cfgNetMqtt.publishQueueSize);
+    publishQueue.dropPolicy = cfgNetMqtt.publishDropPolicy;
+    inFlight.setWindow(cfgNetMqtt.inFlightWindow);
     setMqttState();
     mqttClient.stop();
 }
 
+void NetMqtt::writeApiStatus(JsonWriter& json) {
+    json.beginObject();
+    json.writeBool("enabled", cfgNetMqtt.mqttEnabled);
+    switch (mqttState) {
+        case MQTT_STATE::CONNECTED: json.writeText("state", "connected"); break;
+        case MQTT_STATE::CONNECTING: json.writeText("state", "connecting"); break;
+        case MQTT_STATE::NOBROKER: json.writeText("state", "no broker"); break;
+        default: json.writeText("state", "disconnected"); break;
+    }
+    json.writeText("broker", (cfgNetMqtt.mqttForcedBroker.length() > 0) ? cfgNetMqtt.mqttForcedBroker : (localBrokerIp != INADDR_NONE) ? localBrokerIp.toString() : "");
+    json.writeUint("port", cfgNetMqtt.mqttPort);
+    json.writeUint("qos", cfgNetMqtt.mqttQos);
+    json.writeKey("queue");
+    json.beginObject();
+    json.writeUint("size", publishQueue.getSize());
+    json.writeUint("maxDepth", publishQueue.maxDepth);
+    json.writeUint("enqueued", publishQueue.countEnqueued);
+    json.writeUint("sent", publishQueue.countSent);
+    json.writeUint("dropped", publishQueue.countDropped);
+    json.endObject();
+    json.writeUint("inFlight", inFlight.getSize());
+    json.writeUint("retransmitted", inFlight.countRetransmit);
+    json.writeUint("sentPerSecond", sentPerSecond);
+    json.writeKey("topics");
+    json.beginArray();
+    linkedListMqttTopic.loop([&](DataStructMqttTopic*& current, uint16_t i) {
+        json.writeText(current->getDataTopic());
+    });
+    json.endArray();
+    json.endObject();
+}
+
 String NetMqtt::templateProcessor(uint8_t var) {
     switch (var) {
         case 61:
@@ -213,22 +377,57 @@ String NetMqtt::templateProcessor(uint8_t var) {
             return cfgNetMqtt.mqttForcedBroker;
         case 65:
             return String(cfgNetMqtt.mqttPort);
+        case 66:
+            return String(cfgNetMqtt.publishQueueSize);
+        case 67 ... 69: // Drop policy select
+            return (cfgNetMqtt.publishDropPolicy == var - 67) ? "selected" : "";
+        case 72:
+            return String(cfgNetMqtt.publishTimeBudget);
+        case 73:
+            {
+                StringBuffer<48> text;
+                text.appendUint(publishQueue.countEnqueued).append(" / ").appendUint(publishQueue.countSent).append(" / ").appendUint(publishQueue.countDropped).append(" / ").appendUint(publishQueue.maxDepth);
+                return text.c_str();
+            }
+        case 74:
+            return (cfgNetMqtt.mqttQos == 1) ? "checked" : "";
+        case 75:
+            return String(cfgNetMqtt.inFlightWindow);
+        case 76:
+            {
+                StringBuffer<40> text;
+                text.appendUint(inFlight.getSize()).append(" / ").appendUint(inFlight.countRetransmit).append(" / ").appendUint(sentPerSecond);
+                return text.c_str();
+            }
 
         // Filling of the MQTT topics is better be split, long strings are never good during runtime
-        case 70:
-            // Check if list is empty
+        default:
+            return "";
+    }
+}
+
+boolean NetMqtt::templateListProcessor(uint8_t var, uint16_t index, String& row) {
+    switch (var) {
+        case 70: // Topics
             if (linkedListMqttTopic.getSize() == 0) {
-                return "<li>None</li>";
+                row = "<li>None</li>";
+                return (index == 0);
             }
-            // Set initial bookmark
-            linkedListMqttTopic.bookmarkByIndex(0, true);
-        case 71:
-            return _helper.printFormatted("<li>%s %s %s</li> %s", linkedListMqttTopic.getBookmarkData()->getDataTopic().c_str(),
-                (linkedListMqttTopic.getBookmarkData()->ctrlCallback != nullptr) ? " | " : "",
-                (linkedListMqttTopic.getBookmarkData()->ctrlCallback != nullptr) ? linkedListMqttTopic.getBookmarkData()->getCtrlTopic().c_str() : "",
-                (linkedListMqttTopic.moveBookmark()) ? "%61%" : "");
+            {
+                // The index is the cursor of the request, the list is short
+                DataStructMqttTopic* topic = linkedListMqttTopic.getDataByIndex(index);
+                if (topic == nullptr)
+                    return false;
+                StringBuffer<160> line;
+                line.append("<li>").append(topic->getDataTopic());
+                if (topic->ctrlCallback != nullptr)
+                    line.append(" | ").append(topic->getCtrlTopic());
+                line.append("</li> ");
+                row = line.c_str();
+            }
+            return true;
 
         default:
-            return "";
+            return false;
     }
 }
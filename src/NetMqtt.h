@@ -33,6 +33,7 @@ limitations under the License.
 #include "_Helper_LimitTimer.h"
 
 #include "NetMqtt_TopicList.h"
+#include "NetMqtt_Qos.h"
 
 
 struct CfgNetMqtt : public CfgJsonInterface {
@@ -43,10 +44,22 @@ struct CfgNetMqtt : public CfgJsonInterface {
     uint16_t mqttPort = 1883; // 1883: unencrypted, unauthenticated
     String mqttForcedBroker = ""; // test.mosquitto.org
 
+    uint16_t publishQueueSize = 10; // Messages waiting to be sent
+    uint16_t publishDropPolicy = 0; // 0: drop oldest, 1: drop newest, 2: coalesce to latest per topic
+    uint16_t publishTimeBudget = 5; // [ms] per loop to send queued messages
+
+    uint16_t mqttQos = 0; // 0: at most once, 1: at least once
+    uint16_t inFlightWindow = 4; // QoS 1 messages sent before waiting for the acknowledgement
+
     CfgNetMqtt() : CfgJsonInterface("cfgNetMqtt") {
         addSetting<boolean>("mqttEnabled", &mqttEnabled, [](boolean _) { return true; });
         addSetting<uint16_t>("mqttPort", &mqttPort, [](uint16_t x) { return (x < 1024) ? false : true; }); // port above 1024
         addSetting<String>("mqttForcedBroker", &mqttForcedBroker, [](const String& x) { return ((x.length() > 0) && (x.length() < 6)) ? false : true; } ); // allow empty to remove
+        addSetting<uint16_t>("publishQueueSize", &publishQueueSize, [](uint16_t x) { return ((x == 0) || (x > 100)) ? false : true; }); // 1-100
+        addSetting<uint16_t>("publishDropPolicy", &publishDropPolicy, [](uint16_t x) { return (x > 2) ? false : true; });
+        addSetting<uint16_t>("publishTimeBudget", &publishTimeBudget, [](uint16_t x) { return ((x == 0) || (x > 1000)) ? false : true; }); // 1-1000 ms
+        addSetting<uint16_t>("mqttQos", &mqttQos, [](uint16_t x) { return (x > 1) ? false : true; }); // QoS 2 not implemented
+        addSetting<uint16_t>("inFlightWindow", &inFlightWindow, [](uint16_t x) { return ((x == 0) || (x > 32)) ? false : true; }); // 1-32
     }
 };
 
@@ -63,9 +76,9 @@ class NetMqtt {
          *
          * @param topic The topic to register. It is prefixed with the device ID and suffixed with _data and _ctrl.
          * @param ctrlCallback The function to call when data is received on the topic suffixed with _ctrl. Omit to not subscribe to the topic.
-         * @return Returns the function to write data to MQTT.
+         * @return Returns the function to write data to MQTT. The message is copied to the publish queue, the caller can re-use its buffer.
          */
-        std::function<void(const String& message)> registerMqtt(const String& topic, MqttCtrlCallback ctrlCallback = nullptr);
+        MqttPrint registerMqtt(const String& topic, MqttCtrlCallback ctrlCallback = nullptr);
 
     private:
 
@@ -79,10 +92,19 @@ class NetMqtt {
         MQTT_STATE mqttState;
 
         LinkedListMqttTopic linkedListMqttTopic; // Adaptive size
+        MqttPublishQueue publishQueue; // Size set from config
+        MqttInFlightWindow inFlight; // Size set from config
+        MqttRecentPacketIds recentPacketIds;
+
+        uint16_t inFlightTimeout_ms = 5000; // Retransmit unacknowledged QoS 1 messages
+
+        uint16_t sentPerSecond = 0;
+        uint32_t sentLastSecond = 0;
+        LimitTimer throughputTimer = LimitTimer(1000);
 
         CfgNetMqtt cfgNetMqtt;
 
-        WiFiClient wifiClient;
+        MqttWiFiClient wifiClient;
 
         MqttClient mqttClient = NULL;
 
@@ -96,12 +118,19 @@ class NetMqtt {
         void setMqttState();
 
         void connectMqtt();
+        boolean canWrite(size_t length, const String& topic);
+        void publishQueued();
+        void retransmitInFlight();
+        void writeFailed();
 
         void handleMessage(int messageSize);
 
     public:
 
+        void writeApiStatus(JsonWriter& json);
+
         String templateProcessor(uint8_t var);
+        boolean templateListProcessor(uint8_t var, uint16_t index, String& row);
         const char* webPage = R"===(
 <h3>MQTT Communication</h3> <ul>
 <li>Enable: <form action='/save' method='post'> <input name='mqttEnabled' type='checkbox' %61% value='1'> <input name='mqttEnabled' type='hidden' value='0'> <input type='submit' value='Save'> </form> </li>
@@ -109,6 +138,13 @@ class NetMqtt {
 <li>Local broker: %63% </li>
 <li>Forced external broker:<br> <form action='/save' method='post'> <input name='mqttForcedBroker' value='%64%'> <input type='submit' value='Save'> </form> </li>
 <li>MQTT port: default is 1883 (unsecure) <br> <form action='/save' method='post'> <input name='mqttPort' value='%65%' type='number' min='1024' max='65535'> <input type='submit' value='Save'> </form> </li>
+<li>Publish queue length: <br> <form action='/save' method='post'> <input name='publishQueueSize' value='%66%' type='number' min='1' max='100'> <input type='submit' value='Save'> </form> </li>
+<li>Publish queue full: <br> <form action='/save' method='post'> <select name='publishDropPolicy'> <option value='0' %67%>Drop oldest</option> <option value='1' %68%>Drop newest</option> <option value='2' %69%>Coalesce to latest per topic</option> </select> <input type='submit' value='Save'> </form> </li>
+<li>Publish time budget per loop: <br> <form action='/save' method='post'> <input name='publishTimeBudget' value='%72%' type='number' min='1' max='1000'> [ms] <input type='submit' value='Save'> </form> </li>
+<li>Publish statistics: %73% (enqueued / sent / dropped / max. queue length) </li>
+<li>Quality of service: at least once (QoS 1) instead of at most once (QoS 0) <form action='/save' method='post'> <input name='mqttQos' type='checkbox' %74% value='1'> <input name='mqttQos' type='hidden' value='0'> <input type='submit' value='Save'> </form> </li>
+<li>QoS 1 in-flight window, messages sent before waiting for acknowledgement: <br> <form action='/save' method='post'> <input name='inFlightWindow' value='%75%' type='number' min='1' max='32'> <input type='submit' value='Save'> </form> </li>
+<li>QoS 1 statistics: %76% (unacknowledged / retransmitted / sent per second) </li>
 <li>Topics: <ul> %70% </ul> </li> </ul>
 )===";
 
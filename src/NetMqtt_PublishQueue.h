@@ -0,0 +1,169 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MVP3000_NETMQTT_PUBLISHQUEUE
+#define MVP3000_NETMQTT_PUBLISHQUEUE
+
+#include <Arduino.h>
+
+
+struct DataStructMqttTopic; // See NetMqtt_TopicList.h
+
+/**
+ * @brief Reusable buffer for a single outgoing MQTT message.
+ *
+ * The buffer is only re-allocated to grow. Messages of a topic typically have a similar length, so after the first few messages no allocation is needed.
+ */
+struct MqttMessageSlot {
+    DataStructMqttTopic* mqttTopic = nullptr;
+    char* data = nullptr;
+    uint16_t length = 0;
+    uint16_t capacity = 0;
+
+    ~MqttMessageSlot() { delete[] data; }
+
+    void assign(DataStructMqttTopic* _mqttTopic, const char* message, uint16_t _length) {
+        if (_length > capacity) {
+            delete[] data;
+            data = new char[_length];
+            capacity = _length;
+        }
+        memcpy(data, message, _length);
+        length = _length;
+        mqttTopic = _mqttTopic;
+    }
+};
+
+/**
+ * @brief Bounded queue of outgoing MQTT messages, drained from the loop within a time budget.
+ *
+ * Decouples the publishing modules from the (blocking) TCP write. If the queue is full the drop policy decides which message is lost.
+ * The queue is a ring of reusable message buffers, queueing a message does not allocate memory once the buffers have grown to the message length.
+ */
+struct MqttPublishQueue {
+
+    enum DropPolicy: uint8_t {
+        OLDEST = 0, // Remove the oldest queued message to make room
+        NEWEST = 1, // Reject the new message
+        COALESCE = 2 // Keep only the latest message per topic, replace a queued one in-place
+    };
+    uint8_t dropPolicy = DropPolicy::OLDEST;
+
+    // Only accept messages if there is a broker to send them to eventually
+    boolean accepting = false;
+
+    // Statistics
+    uint32_t countEnqueued = 0;
+    uint32_t countSent = 0;
+    uint32_t countDropped = 0;
+    uint16_t maxDepth = 0;
+
+    ~MqttPublishQueue() { delete[] slots; }
+
+    uint16_t getSize() const { return size; }
+
+    /**
+     * @brief Add a message to the queue, respecting the drop policy.
+     *
+     * @param mqttTopic The topic the message is published to.
+     * @param message The message content, can be binary.
+     * @param length The length of the message.
+     * @return True if the message was queued, false if it was dropped.
+     */
+    boolean enqueue(DataStructMqttTopic* mqttTopic, const char* message, size_t length) {
+        if ((!accepting) || (maxSize == 0))
+            return false;
+
+        if (length > std::numeric_limits<uint16_t>::max()) {
+            countDropped++;
+            return false;
+        }
+
+        if (dropPolicy == DropPolicy::COALESCE) {
+            // Overwrite a message of the same topic that is still waiting, it was not sent yet and is outdated now
+            for (uint16_t i = 0; i < size; i++) {
+                MqttMessageSlot* slot = &slots[(head + i) % maxSize];
+                if (slot->mqttTopic == mqttTopic) {
+                    slot->assign(mqttTopic, message, length);
+                    countEnqueued++;
+                    countDropped++;
+                    return true;
+                }
+            }
+        }
+
+        if (size >= maxSize) {
+            countDropped++;
+            if (dropPolicy == DropPolicy::NEWEST)
+                return false;
+            removeOldest();
+        }
+
+        slots[(head + size) % maxSize].assign(mqttTopic, message, length);
+        size++;
+        countEnqueued++;
+        maxDepth = max(maxDepth, size);
+        return true;
+    }
+
+    MqttMessageSlot* getOldest() { return (size > 0) ? &slots[head] : nullptr; }
+
+    /**
+     * @brief Remove the oldest message after it was sent.
+     */
+    void removeSent() {
+        removeOldest();
+        countSent++;
+    }
+
+    /**
+     * @brief Remove the oldest message, it is handled elsewhere.
+     */
+    void removeOldest() {
+        if (size == 0)
+            return;
+        head = (head + 1) % maxSize;
+        size--;
+    }
+
+    void clear() {
+        head = 0;
+        size = 0;
+    }
+
+    /**
+     * @brief Change the maximum queue length, queued messages are dropped.
+     *
+     * @param newSize The new maximum queue length.
+     */
+    void setMaxSize(uint16_t newSize) {
+        if (newSize == maxSize)
+            return;
+        countDropped += size;
+        clear();
+        delete[] slots;
+        slots = new MqttMessageSlot[newSize];
+        maxSize = newSize;
+    }
+
+    private:
+        MqttMessageSlot* slots = nullptr;
+        uint16_t maxSize = 0;
+        uint16_t head = 0; // Oldest message
+        uint16_t size = 0;
+};
+
+#endif
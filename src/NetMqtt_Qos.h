@@ -0,0 +1,331 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MVP3000_NETMQTT_QOS
+#define MVP3000_NETMQTT_QOS
+
+#include <Arduino.h>
+
+#ifdef ESP8266
+    #include <ESP8266WiFi.h>
+#else
+    #include <WiFi.h>
+#endif
+
+#include "NetMqtt_PublishQueue.h"
+
+
+/**
+ * @brief WiFi client that follows the MQTT packets received by the MQTT library.
+ *
+ * The library waits for the PUBACK of every QoS 1 message it publishes before returning, which limits throughput to one message per round trip.
+ * It also does not expose packet ids. QoS 1 messages are thus written directly to this client, and the incoming PUBACK and PUBLISH packet ids are picked up here while the library reads them.
+ * The topic of incoming messages is picked up as well, the library would otherwise return a copy of it as String.
+ * Its buffer is sized to the longest subscribed topic.
+ */
+struct MqttWiFiClient : public WiFiClient {
+
+    // Called with the packet id of each PUBACK received
+    std::function<void(uint16_t packetId)> onPubAck = nullptr;
+
+    // Packet id (QoS 1+ only) of the most recent PUBLISH received, valid when the library returns the message
+    uint16_t lastPublishPacketId = 0;
+
+    ~MqttWiFiClient() { delete[] lastPublishTopic; }
+
+    /**
+     * @brief Grow the topic buffer to hold a subscribed topic, a longer topic received cannot be one of them.
+     *
+     * @param length The length of the topic.
+     */
+    void reserveTopic(uint16_t length) {
+        if ((lastPublishTopic != nullptr) && (length <= topicCapacity))
+            return;
+        delete[] lastPublishTopic;
+        lastPublishTopic = new char[length + 1];
+        lastPublishTopic[0] = '\0';
+        topicCapacity = length;
+    }
+
+    /**
+     * @brief Topic of the most recent PUBLISH received, valid when the library returns the message.
+     *
+     * @return The topic, cut to the buffer size if isTopicTruncated().
+     */
+    const char* getLastPublishTopic() const { return (lastPublishTopic != nullptr) ? lastPublishTopic : ""; }
+    boolean isTopicTruncated() const { return lastPublishTopicLength > topicCapacity; }
+
+    int read() override {
+        // Not through WiFiClient::read(), on ESP32 it calls the virtual buffer overload and each byte would be followed twice
+        uint8_t b;
+        if (WiFiClient::read(&b, 1) != 1)
+            return -1;
+        followPacket(b);
+        return b;
+    }
+
+    int read(uint8_t* buf, size_t size) override {
+        int len = WiFiClient::read(buf, size);
+        for (int i = 0; i < len; i++)
+            followPacket(buf[i]);
+        return len;
+    }
+
+    /**
+     * @brief Write a QoS 1 PUBLISH packet directly to the connection.
+     *
+     * @param topic The topic to publish to.
+     * @param payload The message payload.
+     * @param payloadLen The length of the payload.
+     * @param packetId The packet id, needs to be unique among the unacknowledged packets.
+     * @param dup Set the DUP flag for a retransmission.
+     * @return True if the complete packet was written.
+     */
+    bool writePublishQos1(const char* topic, const uint8_t* payload, size_t payloadLen, uint16_t packetId, bool dup) {
+        uint16_t topicLen = strlen(topic);
+        uint32_t remainingLen = 2 + topicLen + 2 + payloadLen; // Topic length, topic, packet id, payload
+
+        // Fixed header: PUBLISH, QoS 1, optional DUP
+        uint8_t header[5];
+        uint8_t headerLen = 0;
+        header[headerLen++] = 0x32 | (dup ? 0x08 : 0x00);
+        do { // Variable length encoding of the remaining length
+            header[headerLen] = remainingLen % 128;
+            remainingLen /= 128;
+            if (remainingLen > 0)
+                header[headerLen] |= 0x80;
+            headerLen++;
+        } while (remainingLen > 0);
+
+        uint8_t topicLenBytes[2] = { (uint8_t)(topicLen >> 8), (uint8_t)(topicLen & 0xFF) };
+        uint8_t packetIdBytes[2] = { (uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xFF) };
+
+        return (write(header, headerLen) == headerLen)
+            && (write(topicLenBytes, 2) == 2)
+            && (write((const uint8_t*)topic, topicLen) == topicLen)
+            && (write(packetIdBytes, 2) == 2)
+            && (write(payload, payloadLen) == payloadLen);
+    }
+
+    /**
+     * @brief Reset the packet parser, needed on a new connection.
+     */
+    void resetParser() { rxState = RX_STATE::HEADER; }
+
+    private:
+
+        char* lastPublishTopic = nullptr;
+        uint16_t topicCapacity = 0;
+        uint16_t lastPublishTopicLength = 0; // As received, can be longer than the buffer
+
+        enum class RX_STATE: uint8_t {
+            HEADER = 0,
+            LENGTH = 1,
+            BODY = 2
+        };
+        RX_STATE rxState = RX_STATE::HEADER;
+
+        uint8_t rxType;
+        uint8_t rxQos;
+        uint32_t rxLength;
+        uint32_t rxLengthMultiplier;
+        uint32_t rxPos;
+        uint16_t rxTopicLength;
+        uint16_t rxPacketId;
+
+        void followPacket(uint8_t b) {
+            switch (rxState) {
+                case RX_STATE::HEADER:
+                    rxType = b >> 4;
+                    rxQos = (b >> 1) & 0x03;
+                    rxLength = 0;
+                    rxLengthMultiplier = 1;
+                    rxState = RX_STATE::LENGTH;
+                    break;
+
+                case RX_STATE::LENGTH:
+                    rxLength += (b & 0x7F) * rxLengthMultiplier;
+                    rxLengthMultiplier *= 128;
+                    if (b & 0x80)
+                        break;
+                    rxPos = 0;
+                    rxState = (rxLength == 0) ? RX_STATE::HEADER : RX_STATE::BODY;
+                    break;
+
+                case RX_STATE::BODY:
+                    if (rxType == 4) { // PUBACK: packet id only
+                        if (rxPos == 0)
+                            rxPacketId = b << 8;
+                        if (rxPos == 1)
+                            rxPacketId |= b;
+                    } else if (rxType == 3) { // PUBLISH: topic length, topic, packet id (QoS 1+ only), payload
+                        if (rxPos == 0)
+                            rxTopicLength = b << 8;
+                        if (rxPos == 1) {
+                            rxTopicLength |= b;
+                            lastPublishTopicLength = rxTopicLength;
+                            if (lastPublishTopic != nullptr)
+                                lastPublishTopic[0] = '\0';
+                        }
+                        if ((rxPos >= 2) && (rxPos < rxTopicLength + 2u) && (rxPos - 2 < topicCapacity)) {
+                            lastPublishTopic[rxPos - 2] = b;
+                            lastPublishTopic[rxPos - 1] = '\0';
+                        }
+                        if ((rxQos > 0) && (rxPos >= 2) && (rxPos == rxTopicLength + 2u))
+                            rxPacketId = b << 8;
+                        if ((rxQos > 0) && (rxPos >= 2) && (rxPos == rxTopicLength + 3u))
+                            lastPublishPacketId = rxPacketId | b;
+                    }
+
+                    if (++rxPos < rxLength)
+                        break;
+                    // Packet complete
+                    if ((rxType == 4) && (onPubAck != nullptr))
+                        onPubAck(rxPacketId);
+                    rxState = RX_STATE::HEADER;
+                    break;
+            }
+        }
+};
+
+
+struct MqttInFlightSlot : MqttMessageSlot {
+    boolean inUse = false;
+    boolean resend = false; // Not sent on the current connection yet
+    uint16_t packetId = 0;
+    uint32_t sent_ms = 0;
+};
+
+/**
+ * @brief QoS 1 messages sent but not yet acknowledged by the broker, limited by the in-flight window.
+ *
+ * The message buffers are re-used like in the publish queue.
+ */
+struct MqttInFlightWindow {
+    static const uint8_t MAX_WINDOW = 32;
+
+    // The MQTT library uses low packet ids for its own packets
+    uint16_t nextPacketId = 0x8000;
+
+    uint32_t countRetransmit = 0;
+
+    uint8_t getSize() const { return size; }
+    boolean isFull() const { return size >= window; }
+
+    void setWindow(uint8_t _window) { window = min(_window, MAX_WINDOW); } // Existing messages are kept until acknowledged
+
+    /**
+     * @brief Add a message that is about to be sent.
+     *
+     * @return The in-flight entry holding the packet id to use, nullptr if the window is full.
+     */
+    MqttInFlightSlot* append(MqttMessageSlot* message) {
+        if (isFull())
+            return nullptr;
+        for (uint8_t i = 0; i < MAX_WINDOW; i++) {
+            if (!slots[i].inUse) {
+                slots[i].assign(message->mqttTopic, message->data, message->length);
+                slots[i].inUse = true;
+                slots[i].resend = false;
+                slots[i].packetId = nextPacketId;
+                slots[i].sent_ms = millis();
+                nextPacketId = (nextPacketId == 0xFFFF) ? 0x8000 : nextPacketId + 1;
+                size++;
+                return &slots[i];
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Remove an acknowledged message.
+     *
+     * @param packetId The packet id of the PUBACK.
+     * @return True if the message was found.
+     */
+    boolean acknowledge(uint16_t packetId) {
+        for (uint8_t i = 0; i < MAX_WINDOW; i++) {
+            if (slots[i].inUse && (slots[i].packetId == packetId)) {
+                slots[i].inUse = false;
+                size--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void clear() {
+        for (uint8_t i = 0; i < MAX_WINDOW; i++)
+            slots[i].inUse = false;
+        size = 0;
+    }
+
+    /**
+     * @brief Mark all unacknowledged messages to be sent again, after a reconnect.
+     */
+    void resendAll() {
+        for (uint8_t i = 0; i < MAX_WINDOW; i++)
+            slots[i].resend = slots[i].inUse;
+    }
+
+    /**
+     * @brief Loop through all unacknowledged messages.
+     *
+     * @param callback The function to call for each message.
+     */
+    void loop(std::function<void(MqttInFlightSlot*)> callback) {
+        for (uint8_t i = 0; i < MAX_WINDOW; i++) {
+            if (slots[i].inUse)
+                callback(&slots[i]);
+        }
+    }
+
+    private:
+        MqttInFlightSlot slots[MAX_WINDOW];
+        uint8_t window = 4;
+        uint8_t size = 0;
+};
+
+
+/**
+ * @brief Remembers the packet ids of recently received QoS 1 messages to drop duplicates.
+ */
+struct MqttRecentPacketIds {
+    static const uint8_t SIZE = 8;
+    uint16_t packetIds[SIZE] = { 0 };
+    uint8_t head = 0;
+
+    /**
+     * @brief Check if the message was already handled, remember its packet id.
+     *
+     * @param packetId The packet id of the received message.
+     * @param dup The DUP flag of the received message. Only a retransmission can be a duplicate, the broker may re-use packet ids otherwise.
+     * @return True if the message is a duplicate.
+     */
+    boolean isDuplicate(uint16_t packetId, boolean dup) {
+        if (dup) {
+            for (uint8_t i = 0; i < SIZE; i++) {
+                if (packetIds[i] == packetId)
+                    return true;
+            }
+        }
+        packetIds[head] = packetId;
+        head = (head + 1) % SIZE;
+        return false;
+    }
+};
+
+#endif
@@ -24,43 +24,55 @@ limitations under the License.
 #include "_Helper.h"
 extern _Helper _helper;
 
+#include "NetMqtt_PublishQueue.h"
+
 
 typedef std::function<void(char*)> MqttCtrlCallback;
+typedef std::function<void(const char* message, size_t length)> MqttPrint;
 
 
 struct DataStructMqttTopic {
     String baseTopic;
     MqttCtrlCallback ctrlCallback;
 
-    MqttClient* mqttClient;
+    MqttPublishQueue* publishQueue;
+
+    // Full topics are built once, they are needed for every message
+    String dataTopic;
+    String ctrlTopic;
 
     DataStructMqttTopic() { }
-    DataStructMqttTopic(const String& baseTopic) : baseTopic(baseTopic) { } // For comparision only
-    DataStructMqttTopic(const String& baseTopic, MqttCtrlCallback ctrlCallback, MqttClient* mqttClient) : baseTopic(baseTopic), ctrlCallback(ctrlCallback), mqttClient(mqttClient) { }
-
-    String getCtrlTopic() { String str; str += _helper.ESPX->getChipId(); str += "_"; str += baseTopic; str += "_ctrl";  return str; }
-    String getDataTopic() { String str; str += _helper.ESPX->getChipId(); str += "_"; str += baseTopic; str += "_data";  return str; }
-
-    std::function<void(const String& message)> getMqttPrint() { return std::bind(&DataStructMqttTopic::mqttPrint, this, std::placeholders::_1); }
-    void mqttPrint(const String& message) {
-        // Only write if connected
-        if (mqttClient->connected()) {
-            mqttClient->beginMessage(getDataTopic());
-            mqttClient->print(message);
-            mqttClient->endMessage();
-        }
+    DataStructMqttTopic(const String& baseTopic, MqttCtrlCallback ctrlCallback, MqttPublishQueue* publishQueue) : baseTopic(baseTopic), ctrlCallback(ctrlCallback), publishQueue(publishQueue) {
+        String prefix; prefix += _helper.ESPX->getChipId(); prefix += "_"; prefix += baseTopic;
+        dataTopic = prefix + "_data";
+        ctrlTopic = prefix + "_ctrl";
+    }
+
+    const String& getCtrlTopic() const { return ctrlTopic; }
+    const String& getDataTopic() const { return dataTopic; }
+
+    MqttPrint getMqttPrint() { return std::bind(&DataStructMqttTopic::mqttPrint, this, std::placeholders::_1, std::placeholders::_2); }
+    void mqttPrint(const char* message, size_t length) {
+        // Only queue the message, it is sent from NetMqtt::loop() to not block the caller on a slow connection
+        publishQueue->enqueue(this, message, length);
     }
 };
 
 struct LinkedListMqttTopic : LinkedList3111<DataStructMqttTopic> {
 
-    std::function<void(const String& message)> appendUnique(MqttClient* mqttClient, const String& baseTopic, MqttCtrlCallback ctrlCallback = nullptr) {
-        this->appendUniqueDataStruct(new DataStructMqttTopic(baseTopic, ctrlCallback, mqttClient));
+    MqttPrint appendUnique(MqttPublishQueue* publishQueue, const String& baseTopic, MqttCtrlCallback ctrlCallback = nullptr) {
+        this->appendUniqueDataStruct(new DataStructMqttTopic(baseTopic, ctrlCallback, publishQueue));
         return this->tail->dataStruct->getMqttPrint();
     }
 
-    DataStructMqttTopic* findTopic(const String& baseTopic) {
-        return this->findByContentData(new DataStructMqttTopic(baseTopic));
+    DataStructMqttTopic* findByCtrlTopic(const char* topic) {
+        Node* current = this->head;
+        while (current != nullptr) {
+            if (strcmp(current->dataStruct->ctrlTopic.c_str(), topic) == 0)
+                return current->dataStruct;
+            current = current->next;
+        }
+        return nullptr;
     }
 
     boolean compareContent(DataStructMqttTopic* dataStruct, DataStructMqttTopic* other) override {
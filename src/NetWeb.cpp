@@ -26,9 +26,24 @@ extern _Helper _helper;
 void NetWeb::setup() {
     // IMPORTANT: /foo is matched by foo, foo/, /foo/bar, /foo?bar - but not by /foobar
     // Module folders are registered seperately
+    compileTemplates();
+
+    // The pages are rendered by the template renderer, not the template processor of the server which would rescan the output
     server.on("/", HTTP_GET, [&](AsyncWebServerRequest *request) {
-        request->sendChunked("text/html", std::bind(&NetWeb::responseFillerHome, this, std::placeholders::_1, std::placeholders::_2,std::placeholders::_3), std::bind(&NetWeb::templateProcessorWrapper, this, std::placeholders::_1) );
+        servePage(request, &homeTemplate, -1, &renderTimeHome_us);
     });
+    for (uint8_t i = 0; i < webAssetCount; i++) {
+        const WebAsset* asset = &webAssets[i];
+        server.on(asset->uri, HTTP_GET, [&, asset](AsyncWebServerRequest *request) { serveAsset(request, asset); });
+    }
+    server.on("/api/status", HTTP_GET, std::bind(&NetWeb::serveApiStatus, this, std::placeholders::_1));
+    server.on("/api/cfg", HTTP_GET, std::bind(&NetWeb::serveApiCfg, this, std::placeholders::_1));
+    // JSON body first, the form handler would accept any content type
+    AsyncCallbackJsonWebHandler* cfgJsonHandler = new AsyncCallbackJsonWebHandler("/api/cfg", std::bind(&NetWeb::editApiCfgJson, this, std::placeholders::_1, std::placeholders::_2));
+    cfgJsonHandler->setMethod(HTTP_POST);
+    server.addHandler(cfgJsonHandler);
+    server.on("/api/cfg", HTTP_POST, std::bind(&NetWeb::editApiCfg, this, std::placeholders::_1));
+    server.on("/metrics", HTTP_GET, std::bind(&NetWeb::serveMetrics, this, std::placeholders::_1));
     server.on("/save", std::bind(&NetWeb::editCfg, this, std::placeholders::_1));
     server.on("/checksave", std::bind(&NetWeb::editCfg, this, std::placeholders::_1));
     server.on("/start", std::bind(&NetWeb::startAction, this, std::placeholders::_1));
@@ -45,7 +60,10 @@ void NetWeb::setup() {
 }
 
 void NetWeb::loop() {
-    // There is actually nothing to do here, the async server is running in the background
+    // The async server is running in the background, only resumed event stream clients are caught up here
+    linkedListEventSource.loop([&](DataStructEventSource*& current, uint16_t i) {
+        current->loop();
+    });
 }
 
 
@@ -60,17 +78,13 @@ void NetWeb::registerAction(const String& actionKey, WebActionCallback actionCal
 };
 
 void NetWeb::registerCfg(CfgJsonInterface *cfg, std::function<void()> callback) {
-    linkedListWebCfg.append(cfg, callback);
+    linkedListWebCfg.append(cfg, callback, [&](CfgJsonInterface::SettingNode* setting, const WebSettingsRegistry::Entry* existing) {
+        MVP3000_LOGF(WEB, ERROR, "Setting %s of %s not editable, same hash as %s of %s.", setting->key.c_str(), cfg->cfgName.c_str(), existing->setting->key.c_str(), existing->webCfg->cfg->cfgName.c_str());
+    });
 }
 
 void NetWeb::registerModulePage(const String& uri) {
-    // Death of to many lambdas, no place has all info and objects get destroyed
-    //  1. Bind the onRequest to NetWeb
-    //  2. Use the request->url to select (index of) the module
-    //  3. Store the index in NetWeb
-    //  4. Create the request send using he index to point to the html text
-    //  5. The template processor also uses the index
-    // NOTE: this of course breaks two simultaneous requests to different modules
+    // The request->url selects the module, its index is stored in the context of the request
     server.on(uri.c_str(), HTTP_GET, std::bind(&NetWeb::serveModulePage, this, std::placeholders::_1));
 }
 
@@ -78,8 +92,16 @@ void NetWeb::registerFillerPage(const String& uri, ArRequestHandlerFunction onRe
     server.on(uri.c_str(), HTTP_GET, onRequest);
 }
 
-std::function<void(const String& message)> NetWeb::registerWebSocket(const String& uri, WebSocketCtrlCallback ctrlCallback) {
-    return linkedListWebSocket.appendUnique(uri, ctrlCallback, std::bind(&NetWeb::webSocketEventCallbackWrapper, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5, std::placeholders::_6), &server);
+std::function<void(const String& message)> NetWeb::registerWebSocket(const String& uri, WebSocketCtrlCallback ctrlCallback, uint8_t maxClients) {
+    return linkedListWebSocket.appendUnique(uri, ctrlCallback, std::bind(&NetWeb::webSocketEventCallbackWrapper, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5, std::placeholders::_6), maxClients, &server);
+};
+
+DataStructWebSocket* NetWeb::getWebSocket(const String& uri) {
+    return linkedListWebSocket.findByUri(uri);
+};
+
+DataStructEventSource* NetWeb::registerEventSource(const String& uri, const char* eventName, WebEventReplayCallback replayCallback, uint8_t maxClients) {
+    return linkedListEventSource.appendUnique(uri, eventName, replayCallback, maxClients, &server);
 };
 
 
@@ -89,12 +111,17 @@ void NetWeb::editCfg(AsyncWebServerRequest *request) {
     if (!formInputCheck(request)) {
         return;
     }
-    // This is always a single setting that is updated at a time, try update and respond
-    if (linkedListWebCfg.updateSetting(request->getParam(0)->name(), request->getParam(0)->value())) {
+    // One or several settings, all are checked before any is changed
+    uint16_t countRejected = 0;
+    // The loop may be writing the configurations at the same time
+    mvp.config.lockCfgs();
+    uint16_t countUpdated = linkedListWebCfg.updateSettings(request->params(), [&](int i) { return settingKey(request, i); }, [&](int i) { return request->getParam(i)->value(); }, [&](const String& key) { countRejected++; });
+    mvp.config.unlockCfgs();
+    if ((countUpdated > 0) && (countRejected == 0)) {
         responseRedirect(request, "Settings saved!");
     } else {
         responseRedirect(request, "Input error!");
-        mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "Invalid form input from: %s", request->client()->remoteIP().toString().c_str());
+        MVP3000_LOGF(WEB, WARNING, "Invalid form input from: %s", request->client()->remoteIP().toString().c_str());
     }
 }
 
@@ -108,14 +135,14 @@ void NetWeb::startAction(AsyncWebServerRequest *request) {
     if (webAction == nullptr) {
         // Not found
         responseRedirect(request, "Action not found!");
-        mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "Action not found from: %s", request->client()->remoteIP().toString().c_str());
+        MVP3000_LOGF(WEB, WARNING, "Action not found from: %s", request->client()->remoteIP().toString().c_str());
         return;
     }
 
     if (!webAction->actionCallback(request->params(), [&](int i) { return request->getParam(i)->name(); }, [&](int i) { return request->getParam(i)->value(); })) {
         // Execution failed
         responseRedirect(request, "Invalid action input!");
-        mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "Invalid action input from: %s", request->client()->remoteIP().toString().c_str());
+        MVP3000_LOGF(WEB, WARNING, "Invalid action input from: %s", request->client()->remoteIP().toString().c_str());
         return;
     }
 
@@ -153,32 +180,149 @@ bool NetWeb::formInputCheck(AsyncWebServerRequest *request) {
     }
 
     // Failed confirmation check or no deviceId provided
-    mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Invalid deviceId input from: %s",  request->client()->remoteIP().toString().c_str());
+    MVP3000_LOGF(WEB, INFO, "Invalid deviceId input from: %s",  request->client()->remoteIP().toString().c_str());
     return false;
 }
 
 
+///////////////////////////////////////////////////////////////////////////////////
+
+AsyncResponseStream* NetWeb::beginJsonResponse(AsyncWebServerRequest *request, size_t bufferSize) {
+    AsyncResponseStream *response = request->beginResponseStream("application/json", bufferSize);
+    response->addHeader("Cache-Control", "no-store");
+    return response;
+}
+
+void NetWeb::sendStreamResponse(AsyncWebServerRequest *request, const char* contentType, std::function<void(Print& out)> writeBody) {
+    // Only counts the bytes
+    struct PrintCounter : Print {
+        size_t count = 0;
+        size_t write(uint8_t c) override { count++; return 1; }
+        size_t write(const uint8_t* buffer, size_t size) override { count += size; return size; }
+    } counter;
+    writeBody(counter);
+
+    // Some slack for values that changed in between, the buffer still grows if needed
+    AsyncResponseStream *response = request->beginResponseStream(contentType, counter.count + 32);
+    response->addHeader("Cache-Control", "no-store");
+    writeBody(*response);
+    request->send(response);
+}
+
+void NetWeb::sendJsonResponse(AsyncWebServerRequest *request, std::function<void(JsonWriter& json)> writeJson) {
+    sendStreamResponse(request, "application/json", [&](Print& out) {
+        JsonWriter json(out);
+        writeJson(json);
+    });
+}
+
+void NetWeb::serveApiStatus(AsyncWebServerRequest *request) {
+    sendJsonResponse(request, [&](JsonWriter& json) {
+        json.beginObject();
+        json.writeKey("system");
+        mvp.writeApiStatus(json);
+        json.writeKey("network");
+        mvp.net.writeApiStatus(json);
+        json.writeKey("mqtt");
+        mvp.net.netMqtt.writeApiStatus(json);
+        json.endObject();
+    });
+}
+
+void NetWeb::serveApiCfg(AsyncWebServerRequest *request) {
+    sendJsonResponse(request, [&](JsonWriter& json) { linkedListWebCfg.writeJson(json); });
+}
+
+void NetWeb::serveMetrics(AsyncWebServerRequest *request) {
+    sendStreamResponse(request, "text/plain; version=0.0.4", [&](Print& out) { mvp.metrics.writePrometheus(out); });
+}
+
+void NetWeb::editApiCfg(AsyncWebServerRequest *request) {
+    // Form or query parameters, the keys are unique across all configurations
+    respondApiCfgUpdate(request, request->params(), [&](int i) { return settingKey(request, i); }, [&](int i) { return request->getParam(i)->value(); });
+}
+
+void NetWeb::editApiCfgJson(AsyncWebServerRequest *request, JsonVariant &json) {
+    // Same layout as GET /api/cfg, secret settings are null there and null leaves a setting unchanged
+    uint16_t count = 0;
+    for (JsonPair cfg : json.as<JsonObject>())
+        count += cfg.value().as<JsonObject>().size();
+    String* keys = new String[count];
+    String* values = new String[count];
+    count = 0;
+    for (JsonPair cfg : json.as<JsonObject>()) {
+        for (JsonPair setting : cfg.value().as<JsonObject>()) {
+            JsonVariant value = setting.value();
+            if (value.isNull())
+                continue;
+            keys[count] = setting.key().c_str();
+            if (value.is<bool>())
+                values[count] = value.as<bool>() ? "1" : "0";
+            else if (value.is<long>())
+                values[count] = String(value.as<long>());
+            else
+                values[count] = value.as<String>();
+            count++;
+        }
+    }
+    respondApiCfgUpdate(request, count, [&](int i) { return keys[i]; }, [&](int i) { return values[i]; });
+    delete[] keys;
+    delete[] values;
+}
+
+void NetWeb::respondApiCfgUpdate(AsyncWebServerRequest *request, int count, WebArgKeyValue argKey, WebArgKeyValue argValue) {
+    uint16_t countRejected = 0;
+    // Updating the settings cannot run twice, the response is small
+    AsyncResponseStream *response = beginJsonResponse(request);
+    JsonWriter json(*response);
+    json.beginObject();
+    json.writeKey("rejected");
+    json.beginArray();
+    mvp.config.lockCfgs();
+    uint16_t countUpdated = linkedListWebCfg.updateSettings(count, argKey, argValue, [&](const String& key) {
+        countRejected++;
+        json.writeText(key);
+    });
+    mvp.config.unlockCfgs();
+    json.endArray();
+    json.writeUint("updated", countUpdated);
+    json.endObject();
+
+    if (countRejected > 0) {
+        response->setCode(400);
+        MVP3000_LOGF(WEB, WARNING, "Invalid API input from: %s", request->client()->remoteIP().toString().c_str());
+    }
+    request->send(response);
+}
+
+String NetWeb::settingKey(AsyncWebServerRequest *request, int i) {
+    // Confirmation and the configuration name of older clients are no settings
+    const String& name = request->getParam(i)->name();
+    return (name.equals("deviceId") || name.equals("cfg")) ? String() : name;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////////
 
 void NetWeb::webSocketEventCallbackWrapper(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len, WebSocketCtrlCallback ctrlCallback) {
     switch (type) {
         case WS_EVT_CONNECT:
-            mvp.logger.writeFormatted(CfgLogger::Level::INFO, "WS client %d connected from: %s", client->id(), client->remoteIP().toString().c_str());
+            MVP3000_LOGF(WEB, INFO, "WS client %d connected from: %s", client->id(), client->remoteIP().toString().c_str());
             break;
         case WS_EVT_DISCONNECT:
-            mvp.logger.writeFormatted(CfgLogger::Level::INFO, "WS client %d disconnected.", client->id()); // No IP available
+            MVP3000_LOGF(WEB, INFO, "WS client %d disconnected.", client->id()); // No IP available
             break;
         case WS_EVT_ERROR:
-            mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "WS error from: %s, client %d", client->remoteIP().toString().c_str());
+            MVP3000_LOGF(WEB, WARNING, "WS error from: %s, client %d: %.*s", client->remoteIP().toString().c_str(), client->id(), (int)len, (const char*)data);
             break;
         case WS_EVT_DATA:
-            mvp.logger.writeFormatted(CfgLogger::Level::INFO, "WS client %d data from: %s", client->id(), client->remoteIP().toString().c_str());
+            MVP3000_LOGF(WEB, INFO, "WS client %d data from: %s", client->id(), client->remoteIP().toString().c_str());
             if (ctrlCallback != nullptr) { // Only parse data if there is something to do
                 AwsFrameInfo *info = (AwsFrameInfo*)arg;
                 if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
                     data[len] = 0; // Terminate string
                     // Execute callback
-                    ctrlCallback((char*)data);
+                    ctrlCallback((char*)data, client->id());
                 }
             }
             break;
@@ -205,106 +349,142 @@ void NetWeb::responseMetaRefresh(AsyncWebServerRequest *request) {
     request->send(200, "text/html", webPageRedirect);
 }
 
+void NetWeb::serveAsset(AsyncWebServerRequest *request, const WebAsset* asset) {
+    // Browser has the current version, the ETag only changes with the content
+    if ((request->hasHeader("If-None-Match")) && (request->header("If-None-Match").equals(asset->etag))) {
+        request->send(304);
+        return;
+    }
+
+    AsyncWebServerResponse *response = request->beginResponse_P(200, asset->contentType, asset->data, asset->length);
+    response->addHeader("Content-Encoding", "gzip");
+    response->addHeader("ETag", asset->etag);
+    response->addHeader("Cache-Control", "no-cache"); // Always revalidate, a firmware update may change the content
+    request->send(response);
+}
+
 void NetWeb::serveModulePage(AsyncWebServerRequest *request) {
     // Finde the matching module
-    requestedModuleIndex = -1;
+    int8_t moduleIndex = -1;
     for (uint8_t i = 0; i < mvp.moduleCount; i++) {
         if (mvp.xmodules[i]->uri.equals(request->url())) {
-            requestedModuleIndex = i;
+            moduleIndex = i;
             break;
         }
     }
-    if (requestedModuleIndex == -1) // If the register function is used this can never happen
+    if (moduleIndex == -1) { // If the register function is used this can never happen
         request->redirect("/");
+        return;
+    }
 
-    request->sendChunked("text/html", [&](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
-        return extendedResponseFiller(mvp.xmodules[requestedModuleIndex]->getWebPage(), buffer, maxLen, index);
-    }, std::bind(&NetWeb::templateProcessorWrapper, this, std::placeholders::_1));
+    servePage(request, &moduleTemplates[moduleIndex], moduleIndex, &renderTimeModule_us);
 }
 
+void NetWeb::servePage(AsyncWebServerRequest *request, const WebTemplate* webTemplate, int8_t moduleIndex, uint32_t* renderTime_us) {
+    // The context is owned by the filler, it is released together with the response
+    std::shared_ptr<WebRequestContext> context = std::make_shared<WebRequestContext>();
+    context->moduleIndex = moduleIndex;
 
-///////////////////////////////////////////////////////////////////////////////////
+    // Send message if within lifetime, expire it for the next load
+    if (millis() < postMessageExpiry) {
+        postMessageExpiry = 0;
+        context->postMessage = postMessage;
+    }
 
-size_t NetWeb::responseFillerHome(uint8_t *buffer, size_t maxLen, size_t index) {
-    // Head
-    if (index < strlen(webPageHead))
-        return extendedResponseFiller(webPageHead, buffer, maxLen, index);
-    index -= strlen(webPageHead);
-    // Main
-    if (index < strlen(mvp.webPage))
-        return extendedResponseFiller(mvp.webPage, buffer, maxLen, index);
-    index -= strlen(mvp.webPage);
-    // Log
-    if (index < strlen(mvp.logger.webPage))
-        return extendedResponseFiller(mvp.logger.webPage, buffer, maxLen, index);
-    index -= strlen(mvp.logger.webPage);
-    // Network
-    if (index < strlen(mvp.net.webPage))
-        return extendedResponseFiller(mvp.net.webPage, buffer, maxLen, index);
-    index -= strlen(mvp.net.webPage);
-    // UDP
-    if (index < strlen(mvp.net.netCom.webPage))
-        return extendedResponseFiller(mvp.net.netCom.webPage, buffer, maxLen, index);
-    index -= strlen(mvp.net.netCom.webPage);
-    // MQTT
-    if (index < strlen(mvp.net.netMqtt.webPage))
-        return extendedResponseFiller(mvp.net.netMqtt.webPage, buffer, maxLen, index);
-    // Footer
-    index -= strlen(mvp.net.netMqtt.webPage);
-    return extendedResponseFiller(webPageFoot, buffer, maxLen, index);
+    WebRequestContext* ctx = context.get(); // Not owning, the lambdas live within the context
+    context->renderer.begin(webTemplate,
+        [this, ctx](uint8_t var) { return templateProcessorWrapper(var, ctx); },
+        [this, ctx](uint8_t var, uint16_t index, String& row) { return templateListProcessorWrapper(var, index, row, ctx); });
+
+    // Chunked response, the renderer continues where the last chunk ended
+    request->sendChunked("text/html", [context, renderTime_us](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        size_t len = context->renderer.fill(buffer, maxLen);
+        if (len == 0)
+            *renderTime_us = context->renderer.renderTime_us;
+        return len;
+    });
 }
 
-size_t NetWeb::extendedResponseFiller(const char* html, uint8_t *buffer, size_t maxLen, size_t index) {
-    // Chunked response filler for the html template
-    size_t len = strlen(html);
-    if (index + maxLen > len) {
-        maxLen = len - index;
+
+///////////////////////////////////////////////////////////////////////////////////
+
+void NetWeb::compileTemplates() {
+    // Home page is made of the sections of the framework
+    homeTemplate.append(webPageHead);
+    homeTemplate.append(mvp.webPage);
+    homeTemplate.append(mvp.logger.webPage);
+    homeTemplate.append(mvp.net.webPage);
+    homeTemplate.append(mvp.net.netCom.webPage);
+    homeTemplate.append(mvp.net.netMqtt.webPage);
+    homeTemplate.append(webPageFoot);
+
+    // Module pages use placeholders for the standard head and foot, these are inserted directly
+    delete[] moduleTemplates;
+    moduleTemplates = new WebTemplate[mvp.moduleCount];
+    for (uint8_t i = 0; i < mvp.moduleCount; i++) {
+        moduleTemplates[i].append(mvp.xmodules[i]->getWebPage(), [&](uint8_t var) -> const char* {
+            switch (var) {
+                case 0: return webPageHead;
+                case 9: return webPageFoot;
+                default: return nullptr;
+            }
+        });
     }
-    memcpy(buffer, html + index, maxLen);
-    return maxLen;
 }
 
-String NetWeb::templateProcessorWrapper(const String& var) {
-    if (!_helper.isValidInteger(var)) {
-        mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "Invalid placeholder in template: %s", var.c_str());
-        return "[" + var + "]";
+boolean NetWeb::templateListProcessorWrapper(uint8_t var, uint16_t index, String& row, const WebRequestContext* context) {
+    switch (var) {
+        case 20: // Modules
+            return mvp.templateListProcessor(var, index, row);
+        case 30: // Log
+            return mvp.logger.templateListProcessor(var, index, row);
+        case 70: // MQTT topics
+            return mvp.net.netMqtt.templateListProcessor(var, index, row);
+
+        //  Xmodules placeholders
+        case 100 ... 255:
+            if (context->moduleIndex != -1)
+                return mvp.xmodules[context->moduleIndex]->webPageListProcessor(var, index, row);
+            return false;
+
+        default:
+            return false;
     }
-    int32_t varInt = var.toInt();
-    switch (varInt) {
+}
+
+String NetWeb::templateProcessorWrapper(uint8_t var, const WebRequestContext* context) {
+    switch (var) {
 
         // Main placeholders
-        case 0: // Standard HTML head
-            return webPageHead;
         case 1: // Device ID
             return String(_helper.ESPX->getChipId());
         case 2: // Device IP
             return mvp.net.myIp.toString();
-        case 3: // Post message
-            // Send message if within lifetime
-            if (millis() < postMessageExpiry) {
-                postMessageExpiry = 0; // Expire message for next load, saves a string copy
-                return postMessage;
+        case 3: // Post message, taken over by the request
+            return context->postMessage;
+        case 4: // Render time of the last pages
+            {
+                StringBuffer<24> text;
+                text.appendUint(renderTimeHome_us).append(" / ").appendUint(renderTimeModule_us);
+                return text.c_str();
             }
-            return "";
-        case 9: // Standard HTML foot
-            return webPageFoot;
 
         // Class placeholders
         case 10 ... 29: // System
-            return mvp.templateProcessor(varInt);
+            return mvp.templateProcessor(var);
         case 30 ... 39: // Log
-            return mvp.logger.templateProcessor(varInt);
+            return mvp.logger.templateProcessor(var);
         case 40 ... 49: // Network
-            return mvp.net.templateProcessor(varInt);
+            return mvp.net.templateProcessor(var);
         case 50 ... 59: // UDP
-            return mvp.net.netCom.templateProcessor(varInt);
+            return mvp.net.netCom.templateProcessor(var);
         case 60 ... 79: // MQTT
-            return mvp.net.netMqtt.templateProcessor(varInt);
+            return mvp.net.netMqtt.templateProcessor(var);
 
         //  Xmodules placeholders
         case 100 ... 255:
-            if (requestedModuleIndex != -1)
-                return mvp.xmodules[0]->webPageProcessor(varInt);
+            if (context->moduleIndex != -1)
+                return mvp.xmodules[context->moduleIndex]->webPageProcessor(var);
             return "";
 
         default:
@@ -20,9 +20,12 @@ limitations under the License.
 #include <Arduino.h>
 
 #include <ESPAsyncWebServer.h>
+#include <AsyncJson.h>
 
 #include "Config_JsonInterface.h"
 #include "NetWeb_WebStructs.h"
+#include "NetWeb_Template.h"
+#include "NetWeb_Assets.h"
 
 
 class NetWeb {
@@ -60,10 +63,53 @@ class NetWeb {
          * @brief Register a websocket to be used with the web interface.
          *
          * @param uri The URI of the websocket.
-         * @param dataCallback (optional) The function to execute when data is received. Leave empty to not execute a function.
+         * @param dataCallback (optional) The function to execute when data is received, with the id of the sending client. Leave empty to not execute a function.
+         * @param maxClients (optional) Further clients are rejected, up to WebStreamClients::MAX_CLIENTS.
          * @return Returns the function to write data to the websocket.
          */
-        std::function<void(const String& message)> registerWebSocket(const String& uri, WebSocketCtrlCallback dataCallback = nullptr);
+        std::function<void(const String& message)> registerWebSocket(const String& uri, WebSocketCtrlCallback dataCallback = nullptr, uint8_t maxClients = WebStreamClients::DEFAULT_CLIENTS);
+
+        /**
+         * @brief Get an already registered websocket, to write binary data, set the backpressure, or read the client statistics.
+         *
+         * @param uri The URI of the websocket.
+         * @return Returns the websocket, nullptr if it is not registered.
+         */
+        DataStructWebSocket* getWebSocket(const String& uri);
+
+        /**
+         * @brief Register a server-sent events stream, for clients that cannot keep a websocket open.
+         *
+         * @param uri The URI of the stream.
+         * @param eventName The name of the events.
+         * @param replayCallback (optional) The function to get past events, to resume a reconnecting client. Leave empty to not resume.
+         * @param maxClients (optional) Further clients are rejected, up to WebStreamClients::MAX_CLIENTS.
+         * @return Returns the stream to send events to.
+         */
+        DataStructEventSource* registerEventSource(const String& uri, const char* eventName, WebEventReplayCallback replayCallback = nullptr, uint8_t maxClients = WebStreamClients::DEFAULT_CLIENTS);
+
+        /**
+         * @brief Begin a JSON response, write it using a JsonWriter on the returned stream and send it with request->send().
+         *
+         * The stream holds the whole body on the heap until it is sent, and grows its buffer with every write beyond the initial size.
+         *
+         * @param request The request to respond to.
+         * @param bufferSize (optional) Initial size of the stream buffer.
+         * @return The response stream.
+         */
+        AsyncResponseStream* beginJsonResponse(AsyncWebServerRequest *request, size_t bufferSize = 256);
+
+        /**
+         * @brief Send a response written by a function that is called twice, once to measure the size and once to fill a stream buffer of that size.
+         *
+         * The body is held on the heap until sent, but in one allocation instead of a buffer that is re-allocated while writing. The function must not change any state.
+         *
+         * @param request The request to respond to.
+         * @param contentType The content type.
+         * @param writeBody Writes the body.
+         */
+        void sendStreamResponse(AsyncWebServerRequest *request, const char* contentType, std::function<void(Print& out)> writeBody);
+        void sendJsonResponse(AsyncWebServerRequest *request, std::function<void(JsonWriter& json)> writeJson);
 
     public:
 
@@ -78,6 +124,7 @@ class NetWeb {
         LinkedListWebActions linkedListWebActions = LinkedListWebActions(); // Adaptive size
         LinkedListWebCfg linkedListWebCfg = LinkedListWebCfg(); // Adaptive size
         LinkedListWebSocket linkedListWebSocket; // Adaptive size
+        LinkedListEventSource linkedListEventSource; // Adaptive size
 
         void webSocketEventCallbackWrapper(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len, WebSocketCtrlCallback ctrlCallback);
 
@@ -89,23 +136,43 @@ class NetWeb {
         void responseRedirect(AsyncWebServerRequest *request, const char* message = "");
         void responseMetaRefresh(AsyncWebServerRequest *request);
 
+        // JSON API for automation, written directly to the response stream
+        void serveApiStatus(AsyncWebServerRequest *request);
+        void serveApiCfg(AsyncWebServerRequest *request);
+        void editApiCfg(AsyncWebServerRequest *request);
+        void editApiCfgJson(AsyncWebServerRequest *request, JsonVariant &json);
+        void respondApiCfgUpdate(AsyncWebServerRequest *request, int count, WebArgKeyValue argKey, WebArgKeyValue argValue);
+        String settingKey(AsyncWebServerRequest *request, int i);
+
+        // Runtime metrics in the Prometheus text format
+        void serveMetrics(AsyncWebServerRequest *request);
+
+        // Shared CSS/JS, gzipped in flash, see extras/web
+        void serveAsset(AsyncWebServerRequest *request, const WebAsset* asset);
+
         // Message to serve on next page load after form save
         const char* postMessage = "";
         uint64_t postMessageExpiry = 0;
         uint16_t postMessageLifetime = 15000; // 15 seconds
 
-        int8_t requestedModuleIndex = -1; // None selected, or there is just no module
         void serveModulePage(AsyncWebServerRequest *request);
 
-        size_t responseFillerHome(uint8_t *buffer, size_t maxLen, size_t index);
-        size_t extendedResponseFiller(const char* html, uint8_t *buffer, size_t maxLen, size_t index);
-        String templateProcessorWrapper(const String& var);
+        // Templates are compiled once during setup
+        WebTemplate homeTemplate;
+        WebTemplate* moduleTemplates = nullptr;
+        void compileTemplates();
+
+        // Each request renders with its own context
+        uint32_t renderTimeHome_us = 0;
+        uint32_t renderTimeModule_us = 0;
+        void servePage(AsyncWebServerRequest *request, const WebTemplate* webTemplate, int8_t moduleIndex, uint32_t* renderTime_us);
+        String templateProcessorWrapper(uint8_t var, const WebRequestContext* context);
+        boolean templateListProcessorWrapper(uint8_t var, uint16_t index, String& row, const WebRequestContext* context);
 
         const char* webPageHead = R"===(<!DOCTYPE html> <html lang='en'>
 <head> <title>MVP3000 - Device ID %1%</title>
-<script>function promptId(f) { f.elements['deviceId'].value = prompt('WARNING! Confirm with device ID.'); return (f.elements['deviceId'].value == '') ? false : true ; }</script>
-<style>body { font-family: sans-serif; } table { border-collapse: collapse; border-style: hidden; } td { border: 1px solid black; vertical-align:top; padding:5px; } input:invalid { background-color: #eeccdd; }</style> </head>
-<body> <h2>MVP3000 - Device ID %1%</h2> <h3 style='color: red;'>%3%</h3>)===";
+<link rel='stylesheet' href='/mvp3000.css'> <script src='/mvp3000.js'></script> </head>
+<body> <h2>MVP3000 - Device ID %1%</h2> <h3 class='message'>%3%</h3>)===";
 
         const char* webPageFoot = "<p>&nbsp;</body></html>";
 
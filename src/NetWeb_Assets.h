@@ -0,0 +1,70 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Generated by extras/web/gzip_assets.py, do not edit
+
+#ifndef MVP3000_NETWEB_ASSETS
+#define MVP3000_NETWEB_ASSETS
+
+#include <Arduino.h>
+
+
+// mvp3000.css: 230 bytes, 175 bytes gzipped
+const uint8_t webAsset_mvp3000_css[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x3d, 0x8e, 0x41, 0x0a, 0xc3, 0x30,
+    0x0c, 0x04, 0xef, 0x7d, 0x85, 0xa0, 0x67, 0x17, 0x7a, 0xe8, 0xc5, 0x79, 0x8d, 0x6c, 0x29, 0xa9,
+    0xa8, 0x62, 0x1b, 0xdb, 0x09, 0x09, 0xa5, 0x7f, 0xaf, 0x1d, 0x9a, 0xde, 0x84, 0x66, 0x67, 0x59,
+    0x17, 0x69, 0x87, 0x37, 0x8c, 0x31, 0x54, 0x33, 0xe2, 0x2c, 0xba, 0x5b, 0x28, 0x18, 0x8a, 0x29,
+    0x9c, 0x65, 0x1c, 0xe0, 0x73, 0xa9, 0xe8, 0x94, 0x5b, 0xc4, 0xc5, 0x4c, 0x9c, 0x8d, 0x8f, 0xaa,
+    0x98, 0x0a, 0x5b, 0x38, 0xaf, 0xe1, 0x44, 0xa5, 0xee, 0xda, 0xfe, 0x4f, 0x21, 0xe2, 0x70, 0xa8,
+    0xf4, 0xf7, 0x2c, 0xdc, 0xd3, 0x06, 0x25, 0xaa, 0x10, 0x38, 0x45, 0xff, 0x1a, 0x60, 0xe5, 0x5c,
+    0xc5, 0xa3, 0x1a, 0x54, 0x99, 0x82, 0x85, 0x1a, 0xd3, 0x00, 0x09, 0x89, 0x24, 0x4c, 0x16, 0x1e,
+    0x69, 0xeb, 0x15, 0x12, 0xd2, 0x52, 0xad, 0x84, 0x15, 0xbb, 0xd9, 0xda, 0x9a, 0x3a, 0xe5, 0xb8,
+    0x04, 0xea, 0x4b, 0x62, 0xeb, 0xbd, 0x32, 0x7b, 0x4f, 0xd4, 0xc3, 0xb7, 0x99, 0x4b, 0xc1, 0xa9,
+    0xaf, 0xfd, 0xc1, 0xcc, 0x07, 0xf8, 0x02, 0xde, 0x67, 0x94, 0xc5, 0xe6, 0x00, 0x00, 0x00,
+};
+
+// mvp3000.js: 168 bytes, 144 bytes gzipped
+const uint8_t webAsset_mvp3000_js[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x7d, 0xcc, 0xbd, 0x0a, 0xc2, 0x30,
+    0x14, 0x86, 0xe1, 0x3d, 0x57, 0xf1, 0x39, 0x9d, 0x64, 0xe9, 0x05, 0xb4, 0x14, 0x11, 0x05, 0xc9,
+    0xd2, 0xc1, 0xc5, 0x41, 0x1c, 0x4a, 0x73, 0x82, 0x81, 0xfc, 0x94, 0x34, 0xa9, 0x83, 0x78, 0xef,
+    0x8a, 0x3a, 0xfb, 0xee, 0xcf, 0x6b, 0x6b, 0x9c, 0x8a, 0x4b, 0x11, 0x73, 0x4e, 0x61, 0x2e, 0xda,
+    0x48, 0xab, 0xf0, 0x10, 0x78, 0x67, 0x1b, 0xf6, 0x1c, 0x38, 0x96, 0xe5, 0x42, 0x86, 0x57, 0x37,
+    0xb1, 0x36, 0x74, 0x6d, 0xd6, 0xd1, 0x57, 0x46, 0xff, 0x03, 0x92, 0xce, 0xbb, 0xd3, 0xa0, 0x87,
+    0xe3, 0x06, 0xfb, 0x14, 0xad, 0xcb, 0x01, 0x77, 0x57, 0x6e, 0xf8, 0x02, 0xe8, 0x43, 0x43, 0xaa,
+    0xfb, 0xec, 0x32, 0x97, 0x9a, 0x23, 0xe4, 0xff, 0x6d, 0x0f, 0x22, 0x85, 0x2d, 0xec, 0xe8, 0x17,
+    0x46, 0x8b, 0x92, 0x2b, 0x77, 0xe2, 0x29, 0x5e, 0x87, 0x3a, 0x10, 0x67, 0xa8, 0x00, 0x00, 0x00,
+};
+
+/**
+ * @brief Static asset stored gzipped in flash, served with an ETag for revalidation.
+ */
+struct WebAsset {
+    const char* uri;
+    const char* contentType;
+    const char* etag; // Quoted, as sent in the header
+    const uint8_t* data;
+    size_t length;
+};
+
+const WebAsset webAssets[] = {
+    { "/mvp3000.css", "text/css", "\"6b7295ac3b4ad0cb\"", webAsset_mvp3000_css, sizeof(webAsset_mvp3000_css) },
+    { "/mvp3000.js", "application/javascript", "\"f127b09d8a9f6e47\"", webAsset_mvp3000_js, sizeof(webAsset_mvp3000_js) },
+};
+const uint8_t webAssetCount = sizeof(webAssets) / sizeof(WebAsset);
+
+#endif
@@ -0,0 +1,203 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MVP3000_NETWEB_TEMPLATE
+#define MVP3000_NETWEB_TEMPLATE
+
+#include <Arduino.h>
+
+
+typedef std::function<String(uint8_t var)> WebTemplateProcessor;
+typedef std::function<boolean(uint8_t var, uint16_t index, String& row)> WebTemplateListProcessor;
+
+/**
+ * @brief Web page template split once into literal text and placeholders.
+ *
+ * The html is not copied, literal segments point into it. Rendering is a linear walk over the segments.
+ */
+struct WebTemplate {
+
+    struct Segment {
+        const char* text; // Literal text, nullptr for a placeholder
+        uint16_t value; // Length of the literal text or number of the placeholder
+    };
+
+    Segment* segments = nullptr;
+    uint16_t segmentCount = 0;
+
+    ~WebTemplate() { delete[] segments; }
+
+    /**
+     * @brief Split an html template into literal text and %nn% placeholders and append it.
+     *
+     * @param html The html template, needs to stay valid.
+     * @param getInclude (optional) Returns the html template to insert for a placeholder, nullptr to keep the placeholder.
+     */
+    void append(const char* html, std::function<const char*(uint8_t var)> getInclude = nullptr) {
+        const char* literal = html;
+        const char* current = html;
+        while ((current = strchr(current, '%')) != nullptr) {
+            // Placeholders are 1 to 3 digits between percent signs, everything else is literal text
+            const char* end = current + 1;
+            uint16_t var = 0;
+            while (isdigit(*end) && (end - current <= 3)) {
+                var = var * 10 + (*end - '0');
+                end++;
+            }
+            if ((*end != '%') || (end == current + 1) || (var > 255)) {
+                current++;
+                continue;
+            }
+
+            addSegment(literal, current - literal);
+            const char* include = (getInclude != nullptr) ? getInclude(var) : nullptr;
+            if (include != nullptr)
+                append(include);
+            else
+                addSegment(nullptr, var);
+            literal = current = end + 1;
+        }
+        addSegment(literal, strlen(literal));
+    }
+
+    private:
+
+        uint16_t capacity = 0;
+
+        void addSegment(const char* text, uint16_t value) {
+            if ((text != nullptr) && (value == 0))
+                return;
+            if (segmentCount >= capacity) {
+                // Grows only while compiling during setup
+                capacity = (capacity == 0) ? 16 : capacity * 2;
+                Segment* grown = new Segment[capacity];
+                memcpy(grown, segments, segmentCount * sizeof(Segment));
+                delete[] segments;
+                segments = grown;
+            }
+            segments[segmentCount++] = { text, value };
+        }
+};
+
+
+/**
+ * @brief Renders a compiled template chunk by chunk into the response buffer.
+ *
+ * List placeholders are generated row by row from the list processor. Everything else comes from the template processor.
+ */
+struct WebTemplateRenderer {
+
+    uint32_t renderTime_us = 0; // Time spent filling the buffer for the whole page, excludes waiting for the network
+
+    /**
+     * @brief Start rendering a page.
+     *
+     * @param _webTemplate The compiled template.
+     * @param _processor Returns the value of a placeholder.
+     * @param _listProcessor Returns the row of a list placeholder with the given index, false if there are no (more) rows.
+     */
+    void begin(const WebTemplate* _webTemplate, WebTemplateProcessor _processor, WebTemplateListProcessor _listProcessor) {
+        webTemplate = _webTemplate;
+        processor = _processor;
+        listProcessor = _listProcessor;
+        segment = 0;
+        offset = 0;
+        valuePending = false;
+        renderTime_us = 0;
+    }
+
+    /**
+     * @brief Fill the response buffer with the next part of the page.
+     *
+     * @return The number of bytes written, 0 when the page is complete.
+     */
+    size_t fill(uint8_t* buffer, size_t maxLen) {
+        uint32_t start_us = micros();
+        size_t len = 0;
+        while (len < maxLen) {
+            if (valuePending) {
+                len += copy(buffer + len, maxLen - len, value.c_str(), value.length());
+                if (offset < value.length())
+                    break;
+                // Value complete, next list row or next segment
+                offset = 0;
+                value = "";
+                if (inList && listProcessor(webTemplate->segments[segment].value, ++listIndex, value))
+                    continue;
+                valuePending = false;
+                segment++;
+                continue;
+            }
+
+            if (segment >= webTemplate->segmentCount)
+                break;
+
+            const WebTemplate::Segment& current = webTemplate->segments[segment];
+            if (current.text != nullptr) {
+                len += copy(buffer + len, maxLen - len, current.text, current.value);
+                if (offset < current.value)
+                    break;
+                offset = 0;
+                segment++;
+                continue;
+            }
+
+            // Placeholder: list rows or single value
+            listIndex = 0;
+            value = "";
+            inList = listProcessor(current.value, listIndex, value);
+            if (!inList)
+                value = processor(current.value);
+            valuePending = true;
+        }
+        renderTime_us += micros() - start_us;
+        return len;
+    }
+
+    private:
+
+        const WebTemplate* webTemplate;
+        WebTemplateProcessor processor;
+        WebTemplateListProcessor listProcessor;
+
+        uint16_t segment;
+        size_t offset; // Within the current literal or value
+        String value;
+        boolean valuePending;
+        boolean inList;
+        uint16_t listIndex;
+
+        size_t copy(uint8_t* buffer, size_t maxLen, const char* text, size_t textLen) {
+            size_t len = min(maxLen, textLen - offset);
+            memcpy(buffer, text + offset, len);
+            offset += len;
+            return len;
+        }
+};
+
+
+/**
+ * @brief State of a single page request, it lives as long as the response.
+ *
+ * Nothing of the rendering is stored in the server or the modules, so several pages can be served at the same time.
+ */
+struct WebRequestContext {
+    WebTemplateRenderer renderer; // Includes the list cursor
+    int8_t moduleIndex = -1; // Module of the requested page, -1 for the home page
+    const char* postMessage = ""; // Message of a previous form action
+};
+
+#endif
@@ -75,53 +75,383 @@ struct DataStructWebCfg {
     DataStructWebCfg(CfgJsonInterface* cfg, std::function<void()> callback) : cfg(cfg), callback(callback) { }
 };
 
+/**
+ * @brief Settings of all registered configurations, indexed by the hash of their key.
+ *
+ * The keys of all configurations share one namespace, a setting with the hash of an already registered one is rejected.
+ * Open addressing with linear probing, the table is at most half full and only grows while registering during setup.
+ */
+struct WebSettingsRegistry {
+    struct Entry {
+        CfgJsonInterface::SettingNode* setting; // Empty slot if nullptr
+        DataStructWebCfg* webCfg;
+    };
+
+    ~WebSettingsRegistry() { delete[] entries; }
+
+    /**
+     * @brief Add a setting of a configuration.
+     *
+     * @return The entry registered before with the same hash, nullptr if the setting was added.
+     */
+    const Entry* add(CfgJsonInterface::SettingNode* setting, DataStructWebCfg* webCfg) {
+        const Entry* existing = find(setting->hash);
+        if (existing != nullptr)
+            return existing;
+        if ((count + 1) * 2 > capacity)
+            grow();
+        insert(setting, webCfg);
+        count++;
+        return nullptr;
+    }
+
+    /**
+     * @brief Find the setting with the given key hash.
+     *
+     * @return The entry, nullptr if not found.
+     */
+    Entry* find(uint32_t hash) {
+        if (capacity == 0)
+            return nullptr;
+        for (uint16_t i = hash & (capacity - 1); entries[i].setting != nullptr; i = (i + 1) & (capacity - 1)) {
+            if (entries[i].setting->hash == hash)
+                return &entries[i];
+        }
+        return nullptr;
+    }
+
+    private:
+
+        Entry* entries = nullptr;
+        uint16_t capacity = 0; // Power of two
+        uint16_t count = 0;
+
+        void insert(CfgJsonInterface::SettingNode* setting, DataStructWebCfg* webCfg) {
+            uint16_t i = setting->hash & (capacity - 1);
+            while (entries[i].setting != nullptr)
+                i = (i + 1) & (capacity - 1);
+            entries[i].setting = setting;
+            entries[i].webCfg = webCfg;
+        }
+
+        void grow() {
+            Entry* previous = entries;
+            uint16_t previousCapacity = capacity;
+            capacity = (capacity == 0) ? 32 : capacity * 2;
+            entries = new Entry[capacity]();
+            for (uint16_t i = 0; i < previousCapacity; i++) {
+                if (previous[i].setting != nullptr)
+                    insert(previous[i].setting, previous[i].webCfg);
+            }
+            delete[] previous;
+        }
+};
+
 struct LinkedListWebCfg : LinkedList3100<DataStructWebCfg> {
     // Function to save the configuration
     std::function<void(CfgJsonInterface&)> saveCfgFkt;
 
+    WebSettingsRegistry registry;
+
     void setSaveCfgFkt(std::function<void(CfgJsonInterface&)> saveCfgFkt) {
         this->saveCfgFkt = saveCfgFkt;
     }
 
-    void append(CfgJsonInterface* cfg, std::function<void()> callback) {
-        this->appendDataStruct(new DataStructWebCfg(cfg, callback));
+    /**
+     * @brief Append a configuration and add its settings to the registry.
+     *
+     * @param onCollision Called for each setting that is not added because its hash is already registered.
+     */
+    void append(CfgJsonInterface* cfg, std::function<void()> callback, std::function<void(CfgJsonInterface::SettingNode*, const WebSettingsRegistry::Entry*)> onCollision) {
+        DataStructWebCfg* webCfg = new DataStructWebCfg(cfg, callback);
+        this->appendDataStruct(webCfg);
+        for (CfgJsonInterface::SettingNode* setting = cfg->head; setting != nullptr; setting = setting->next) {
+            const WebSettingsRegistry::Entry* existing = registry.add(setting, webCfg);
+            if (existing != nullptr)
+                onCollision(setting, existing);
+        }
     }
 
-    bool updateSetting(const String& key, const String& value) {
-        boolean success = false;
-        this->loop([&](DataStructWebCfg* current, uint16_t i) {
-            // Try to update value, if successful save Cfg and return
-            if (current->cfg->updateSingleValue(key, value)) {
-                saveCfgFkt(*current->cfg);
-                if (current->callback != nullptr) {
-                    current->callback();
-                }
-                success = true; // set flag
-                return;
-            }
+    DataStructWebCfg* findByName(const String& cfgName) {
+        DataStructWebCfg* found = nullptr;
+        this->loop([&](DataStructWebCfg*& current, uint16_t i) {
+            if ((found == nullptr) && (current->cfg->cfgName.equals(cfgName)))
+                found = current;
+        });
+        return found;
+    }
+
+    void writeJson(JsonWriter& json) {
+        json.beginObject();
+        this->loop([&](DataStructWebCfg*& current, uint16_t i) {
+            json.writeKey(current->cfg->cfgName.c_str());
+            current->cfg->writeJson(json);
         });
-        return success;
+        json.endObject();
+    }
+
+    void saveAndCallback(DataStructWebCfg* webCfg) {
+        saveCfgFkt(*webCfg->cfg);
+        if (webCfg->callback != nullptr) {
+            webCfg->callback();
+        }
+    }
+
+    /**
+     * @brief Update several settings at once, of any configuration. Nothing is changed if one of them is rejected.
+     *
+     * Each affected configuration is saved and its callback called once.
+     *
+     * @param count The number of arguments.
+     * @param argKey Returns the key of an argument, empty if the argument is not a setting.
+     * @param argValue Returns the value of an argument.
+     * @param onRejected Called with the key of each unknown or invalid setting.
+     * @return The number of settings updated, 0 if any was rejected.
+     */
+    uint16_t updateSettings(int count, WebArgKeyValue argKey, WebArgKeyValue argValue, std::function<void(const String& key)> onRejected) {
+        // Resolve and check all first
+        WebSettingsRegistry::Entry** resolved = new WebSettingsRegistry::Entry*[count]();
+        uint32_t* hashes = new uint32_t[count]();
+        boolean valid = true;
+        for (int i = 0; i < count; i++) {
+            String key = argKey(i);
+            if (key.length() == 0)
+                continue;
+            hashes[i] = _helper.hashStringDjb2(key.c_str());
+            // A key given twice keeps its first value, like a checked checkbox followed by its hidden default
+            if (isRepeated(hashes, i))
+                continue;
+            WebSettingsRegistry::Entry* entry = registry.find(hashes[i]);
+            if ((entry == nullptr) || !entry->setting->checkString(argValue(i))) {
+                valid = false;
+                onRejected(key);
+                continue;
+            }
+            resolved[i] = entry;
+        }
+
+        uint16_t updated = 0;
+        if (valid) {
+            for (int i = 0; i < count; i++) {
+                if ((resolved[i] != nullptr) && resolved[i]->setting->setString(argValue(i)))
+                    updated++;
+            }
+            // Save once per configuration
+            this->loop([&](DataStructWebCfg*& current, uint16_t j) {
+                for (int i = 0; i < count; i++) {
+                    if ((resolved[i] != nullptr) && (resolved[i]->webCfg == current)) {
+                        saveAndCallback(current);
+                        break;
+                    }
+                }
+            });
+        }
+
+        delete[] resolved;
+        delete[] hashes;
+        return updated;
     }
+
+    private:
+
+        boolean isRepeated(uint32_t* hashes, int index) {
+            for (int i = 0; i < index; i++) {
+                if (hashes[i] == hashes[index])
+                    return true;
+            }
+            return false;
+        }
 };
 
 
 ///////////////////////////////////////////////////////////////////////////////////
 
-typedef std::function<void(char*)> WebSocketCtrlCallback;
+typedef std::function<void(char* data, uint32_t clientId)> WebSocketCtrlCallback;
 typedef std::function<void(AsyncWebSocketClient *, AwsEventType, void*, uint8_t*, size_t, WebSocketCtrlCallback)> WebSocketEventCallbackWrapper;
 
-struct DataStructWebSocket {
+/**
+ * @brief Statistics of a single websocket or event source client.
+ */
+struct WebSocketClientStats {
+    uint32_t id = 0; // Client ids start at 1, 0 is unused
+    uint32_t countQueued = 0;
+    uint32_t countDropped = 0;
+    uint32_t bytes = 0;
+    boolean directOnly = false; // Client receives only messages sent to it with sendClient()
+    uint32_t lastEventId = 0; // Event source only, id of the last event sent
+    boolean replaying = false; // Event source only, resumed client is catching up from the history
+};
+
+/**
+ * @brief Connected clients of a websocket or an event source and the limits for them, the same for both.
+ */
+struct WebStreamClients {
+    // Messages are queued per client without limit by the library, a slow client would use up the heap
+    enum Overflow: uint8_t {
+        COALESCE = 0, // Skip messages until the queue drained, the next one sent is the latest
+        DISCONNECT = 1 // Close the connection of the slow client
+    };
+    uint8_t maxQueued = 8;
+    uint8_t overflow = Overflow::COALESCE;
+
+    // Slots for clients, the limit of each socket can be lower, further clients are rejected
+    static const uint8_t MAX_CLIENTS = 8;
+    static const uint8_t DEFAULT_CLIENTS = 4;
+    WebSocketClientStats clientStats[MAX_CLIENTS];
+    uint8_t maxClients = DEFAULT_CLIENTS;
+
+    // Since boot, the client statistics are reset on reconnect
+    uint32_t countDropped = 0;
+
+    /**
+     * @brief Set the per-client limit of queued messages and what happens when it is reached.
+     *
+     * @param _maxQueued Messages queued per client.
+     * @param _overflow Coalesce to the latest message or disconnect the client.
+     */
+    void setBackpressure(uint8_t _maxQueued, uint8_t _overflow) {
+        maxQueued = _maxQueued;
+        overflow = _overflow;
+    }
+
+    /**
+     * @brief Exclude a client from messages sent to all clients, for example because it gets its own data stream.
+     *
+     * @param id The client id.
+     * @param directOnly True to only send messages with sendClient() to the client.
+     */
+    void setDirectOnly(uint32_t id, boolean directOnly) {
+        lockClients();
+        WebSocketClientStats* stats = findClient(id);
+        if (stats != nullptr)
+            stats->directOnly = directOnly;
+        unlockClients();
+    }
+
+    /**
+     * @brief Loop through the connected clients.
+     *
+     * @param callback The function to call for each client.
+     */
+    void loopClients(std::function<void(WebSocketClientStats*)> callback) {
+        lockClients();
+        for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+            if (clientStats[i].id != 0)
+                callback(&clientStats[i]);
+        }
+        unlockClients();
+    }
+
+    boolean hasClients() {
+        return getClientCount() > 0;
+    }
+
+    uint8_t getClientCount() {
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+            if (clientStats[i].id != 0)
+                count++;
+        }
+        return count;
+    }
+
+    // Client callbacks of the network task change the slots while the loop sends, both hold the lock
+#if defined(ESP32)
+    // Recursive, closing a client from the loop calls the disconnect callback right away
+    void lockClients() { xSemaphoreTakeRecursive(clientsMutex, portMAX_DELAY); }
+    void unlockClients() { xSemaphoreGiveRecursive(clientsMutex); }
+#else
+    // Network callbacks run between loop iterations, never at the same time
+    void lockClients() { }
+    void unlockClients() { }
+#endif
+
+    protected:
+
+#if defined(ESP32)
+        SemaphoreHandle_t clientsMutex = xSemaphoreCreateRecursiveMutex();
+#endif
+
+        WebSocketClientStats* findClient(uint32_t id) {
+            for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+                if (clientStats[i].id == id)
+                    return &clientStats[i];
+            }
+            return nullptr;
+        }
+
+        // Returns the slot index, -1 if the limit is reached
+        int8_t addClient(uint32_t id) {
+            if (getClientCount() >= maxClients)
+                return -1;
+            for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+                if (clientStats[i].id == 0) {
+                    clientStats[i] = WebSocketClientStats();
+                    clientStats[i].id = id;
+                    return i;
+                }
+            }
+            return -1;
+        }
+
+        void removeClient(uint32_t id) {
+            WebSocketClientStats* stats = findClient(id);
+            if (stats != nullptr)
+                stats->id = 0;
+        }
+
+        /**
+         * @brief Check the queue of the client before sending a message.
+         *
+         * @return False if the message is dropped, the caller closes the connection if the overflow is set to disconnect.
+         */
+        boolean checkQueue(WebSocketClientStats* stats, size_t queued, boolean queueFull) {
+            if ((queued < maxQueued) && !queueFull)
+                return true;
+            stats->countDropped++;
+            countDropped++;
+            return false;
+        }
+
+        void countSent(WebSocketClientStats* stats, size_t length) {
+            stats->countQueued++;
+            stats->bytes += length;
+        }
+};
+
+struct DataStructWebSocket : WebStreamClients {
     uint32_t uriHash;
 
     AsyncWebSocket* websocket;
     WebSocketCtrlCallback ctrlCallback;
     WebSocketEventCallbackWrapper webSocketEventCallbackWrapper;
 
-    DataStructWebSocket(const String& uri) : uriHash(_helper.hashStringDjb2(uri.c_str())) { };
-    DataStructWebSocket(const String& uri, WebSocketCtrlCallback _ctrlCallback, WebSocketEventCallbackWrapper _webSocketEventCallbackWrapper, AsyncWebServer *server) : uriHash(_helper.hashStringDjb2(uri.c_str())), ctrlCallback(_ctrlCallback), webSocketEventCallbackWrapper(_webSocketEventCallbackWrapper) {
+    DataStructWebSocket(const String& uri, WebSocketCtrlCallback _ctrlCallback, WebSocketEventCallbackWrapper _webSocketEventCallbackWrapper, uint8_t _maxClients, AsyncWebServer *server) : uriHash(_helper.hashStringDjb2(uri.c_str())), ctrlCallback(_ctrlCallback), webSocketEventCallbackWrapper(_webSocketEventCallbackWrapper) {
+        maxClients = (_maxClients < MAX_CLIENTS) ? _maxClients : MAX_CLIENTS;
         // Create websocket and attached to server
         websocket = new AsyncWebSocket(uri);
         websocket->onEvent([&](AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
+            if (type == WS_EVT_CONNECT) {
+                lockClients();
+                int8_t slot = addClient(client->id());
+                unlockClients();
+                if (slot < 0) {
+                    // Reported as error instead of connect, the disconnect that follows the close is not reported
+                    static const char reason[] = "client limit reached";
+                    webSocketEventCallbackWrapper(client, WS_EVT_ERROR, nullptr, (uint8_t*)reason, sizeof(reason) - 1, ctrlCallback);
+                    client->close();
+                    return;
+                }
+            }
+            if (type == WS_EVT_DISCONNECT) {
+                // Waits for the loop to finish sending, the client is deleted after this returns
+                lockClients();
+                boolean known = (findClient(client->id()) != nullptr);
+                removeClient(client->id());
+                unlockClients();
+                if (!known)
+                    return;
+            }
             webSocketEventCallbackWrapper(client, type, arg, data, len, ctrlCallback);
         });
         server->addHandler(websocket);
@@ -129,21 +459,216 @@ struct DataStructWebSocket {
 
     std::function<void(const String& message)> getTextAll() { return std::bind(&DataStructWebSocket::textAll, this, std::placeholders::_1); }
     void textAll(const String& message) {
-        websocket->textAll(message);
+        sendAll(message.c_str(), message.length(), false);
+    }
+
+    std::function<void(const uint8_t* data, size_t length)> getBinaryAll() { return std::bind(&DataStructWebSocket::binaryAll, this, std::placeholders::_1, std::placeholders::_2); }
+    void binaryAll(const uint8_t* data, size_t length) {
+        sendAll((const char*)data, length, true);
     }
+
+    /**
+     * @brief Send a message to a single client, respecting the backpressure settings.
+     *
+     * @param id The client id.
+     * @param data The message.
+     * @param length The length of the message.
+     * @param binary Send as binary instead of text frame.
+     * @return False if the client is not connected (anymore).
+     */
+    boolean sendClient(uint32_t id, const uint8_t* data, size_t length, boolean binary) {
+        lockClients();
+        WebSocketClientStats* stats = findClient(id);
+        boolean sent = (stats != nullptr) && sendToClient(stats, (const char*)data, length, binary);
+        unlockClients();
+        return sent;
+    }
+
+    private:
+
+        void sendAll(const char* data, size_t length, boolean binary) {
+            lockClients();
+            for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+                if ((clientStats[i].id != 0) && !clientStats[i].directOnly)
+                    sendToClient(&clientStats[i], data, length, binary);
+            }
+            unlockClients();
+        }
+
+        boolean sendToClient(WebSocketClientStats* stats, const char* data, size_t length, boolean binary) {
+            AsyncWebSocketClient* client = websocket->client(stats->id);
+            if ((client == nullptr) || (client->status() != WS_CONNECTED))
+                return false;
+
+            if (!checkQueue(stats, client->queueLen(), client->queueIsFull())) {
+                if (overflow == Overflow::DISCONNECT)
+                    client->close();
+                return true;
+            }
+
+            if (binary)
+                client->binary(data, length);
+            else
+                client->text(data, length);
+            countSent(stats, length);
+            return true;
+        }
 };
 
 struct LinkedListWebSocket : LinkedList3111<DataStructWebSocket> {
 
-    std::function<void(const String& message)> appendUnique(const String& uri, WebSocketCtrlCallback ctrlCallback, WebSocketEventCallbackWrapper webSocketEventCallbackWrapper, AsyncWebServer* server) {
-        this->appendUniqueDataStruct(new DataStructWebSocket(uri, ctrlCallback, webSocketEventCallbackWrapper, server));
+    std::function<void(const String& message)> appendUnique(const String& uri, WebSocketCtrlCallback ctrlCallback, WebSocketEventCallbackWrapper webSocketEventCallbackWrapper, uint8_t maxClients, AsyncWebServer* server) {
+        this->appendUniqueDataStruct(new DataStructWebSocket(uri, ctrlCallback, webSocketEventCallbackWrapper, maxClients, server));
         return this->tail->dataStruct->getTextAll();
     }
 
+    DataStructWebSocket* findByUri(const String& uri) {
+        uint32_t uriHash = _helper.hashStringDjb2(uri.c_str());
+        DataStructWebSocket* webSocket = nullptr;
+        this->loop([&](DataStructWebSocket*& current, uint16_t i) {
+            if (current->uriHash == uriHash)
+                webSocket = current;
+        });
+        return webSocket;
+    }
+
     boolean compareContent(DataStructWebSocket* dataStruct, DataStructWebSocket* other) override {
         return dataStruct->uriHash == other->uriHash;
     }
 };
 
 
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get the next event from the history of a stream, to resume a client after a reconnect.
+ *
+ * @param lastId The id of the last event the client received.
+ * @param message Set to the message of the next event, valid until the next call.
+ * @return The id of the next event, 0 if there is none.
+ */
+typedef std::function<uint32_t(uint32_t lastId, const char*& message)> WebEventReplayCallback;
+
+/**
+ * @brief Server-sent events (text/event-stream) for clients that cannot use a websocket.
+ *
+ * Events are numbered, a reconnecting client sends the id of the last event it received and first gets the newer events from the history.
+ * The catching up is done from the loop and only as far as the queue limit allows.
+ * The library deletes a client right after the disconnect callback, so the client pointers are only used while holding the client lock.
+ */
+struct DataStructEventSource : WebStreamClients {
+    uint32_t uriHash;
+
+    AsyncEventSource* eventSource;
+    const char* eventName;
+    WebEventReplayCallback replayCallback;
+
+    AsyncEventSourceClient* clients[MAX_CLIENTS] = { nullptr }; // Same slots as the client statistics
+    uint32_t nextClientId = 1;
+    uint32_t newestSentId = 0; // No client can have received a newer event in this boot
+
+    DataStructEventSource(const String& uri, const char* _eventName, WebEventReplayCallback _replayCallback, uint8_t _maxClients, AsyncWebServer *server) : uriHash(_helper.hashStringDjb2(uri.c_str())), eventName(_eventName), replayCallback(_replayCallback) {
+        maxClients = (_maxClients < MAX_CLIENTS) ? _maxClients : MAX_CLIENTS;
+        eventSource = new AsyncEventSource(uri);
+        eventSource->onConnect([&](AsyncEventSourceClient *client) {
+            lockClients();
+            int8_t slot = addClient(nextClientId++);
+            if (slot >= 0) {
+                clients[slot] = client;
+                // Resume after the last event the client received
+                // Ids start over after a reboot and browsers resend the last id of the previous boot, then replay everything stored
+                uint32_t lastId = client->lastId();
+                clientStats[slot].lastEventId = (lastId > newestSentId) ? 0 : lastId;
+                clientStats[slot].replaying = (lastId > 0) && (replayCallback != nullptr);
+            }
+            unlockClients();
+            if (slot < 0)
+                client->close();
+        });
+        eventSource->onDisconnect([&](AsyncEventSourceClient *client) {
+            // Waits for the loop to finish sending, the client is deleted after this returns
+            lockClients();
+            for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+                if (clients[i] == client) {
+                    clients[i] = nullptr;
+                    clientStats[i].id = 0;
+                }
+            }
+            unlockClients();
+        });
+        server->addHandler(eventSource);
+    }
+
+    /**
+     * @brief Send an event to all clients that are not catching up.
+     *
+     * @param message The message, without line breaks.
+     * @param id The id of the event, increasing.
+     */
+    void sendAll(const char* message, uint32_t id) {
+        lockClients();
+        newestSentId = id;
+        for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+            if ((clients[i] != nullptr) && !clientStats[i].directOnly && !clientStats[i].replaying)
+                sendToClient(i, message, id);
+        }
+        unlockClients();
+    }
+
+    /**
+     * @brief Continue to send the history to resumed clients.
+     */
+    void loop() {
+        lockClients();
+        for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+            if ((clients[i] == nullptr) || !clientStats[i].replaying)
+                continue;
+            // Closing a client for overflow clears its slot
+            while ((clients[i] != nullptr) && (clients[i]->packetsWaiting() < maxQueued)) {
+                const char* message;
+                uint32_t id = replayCallback(clientStats[i].lastEventId, message);
+                if (id == 0) {
+                    clientStats[i].replaying = false; // Caught up, continue with live events
+                    break;
+                }
+                sendToClient(i, message, id);
+            }
+        }
+        unlockClients();
+    }
+
+    private:
+
+        void sendToClient(uint8_t slot, const char* message, uint32_t id) {
+            // Already sent while catching up
+            if (id <= clientStats[slot].lastEventId)
+                return;
+
+            if (!checkQueue(&clientStats[slot], clients[slot]->packetsWaiting(), false)) {
+                if (overflow == Overflow::DISCONNECT)
+                    clients[slot]->close();
+                return;
+            }
+
+            clients[slot]->send(message, eventName, id);
+            clientStats[slot].lastEventId = id;
+            if (id > newestSentId)
+                newestSentId = id; // Replayed events can be newer than the last live one
+            countSent(&clientStats[slot], strlen(message));
+        }
+};
+
+struct LinkedListEventSource : LinkedList3101<DataStructEventSource> {
+
+    DataStructEventSource* appendUnique(const String& uri, const char* eventName, WebEventReplayCallback replayCallback, uint8_t maxClients, AsyncWebServer* server) {
+        this->appendUniqueDataStruct(new DataStructEventSource(uri, eventName, replayCallback, maxClients, server));
+        return this->tail->dataStruct;
+    }
+
+    boolean compareContent(DataStructEventSource* dataStruct, DataStructEventSource* other) override {
+        return dataStruct->uriHash == other->uriHash;
+    }
+};
+
+
 #endif
\ No newline at end of file
@@ -25,7 +25,7 @@ extern _Helper _helper;
 
 void XmoduleSensor::setup() {
     if (cfgXmoduleSensor.dataValueCount == 0) {
-        mvp.logger.write(CfgLogger::Level::ERROR, "Data value count is zero.");
+        MVP3000_LOG(SENSOR, ERROR, "Data value count is zero.");
         return;
     }
 
@@ -36,8 +36,15 @@ void XmoduleSensor::setup() {
     if (cfgXmoduleSensor.reportingInterval > 0)
         sensorTimer.restart(cfgXmoduleSensor.reportingInterval);
 
+    // Hardware random number unless seeded
+    bootId = random(1, INT32_MAX);
+
+    // The logger opened the port with the default rate, binary output needs it open in any case
+    if ((cfgXmoduleSensor.serialBaud > 0) || (cfgXmoduleSensor.serialOutput == CfgXmoduleSensor::SerialOutput::SERIAL_BINARY))
+        applySerialBaud();
+
     // Register config to make it web-editable
-    mvp.net.netWeb.registerCfg(&cfgXmoduleSensor);
+    mvp.net.netWeb.registerCfg(&cfgXmoduleSensor, std::bind(&XmoduleSensor::saveCfgCallback, this));
 
     // Register webpage actions
     mvp.net.netWeb.registerAction("measureOffset", [&](int args, WebArgKeyValue argKey, WebArgKeyValue argValue) {
@@ -69,20 +76,49 @@ void XmoduleSensor::setup() {
         request->sendChunked("text/html", std::bind(&XmoduleSensor::csvLastestResponseFiller, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
     });
 
+    // Stored data, optionally only the part since the last poll: since, sinceTime, limit, step, channels
     mvp.net.netWeb.registerFillerPage(uri + "datasraw", [&](AsyncWebServerRequest *request) {
-        request->sendChunked("application/octet-stream", std::bind(&XmoduleSensor::csvRawResponseFiller, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        serveHistory(request, false);
     });
 
     mvp.net.netWeb.registerFillerPage(uri + "datasscaled", [&](AsyncWebServerRequest *request) {
-        request->sendChunked("application/octet-stream", std::bind(&XmoduleSensor::csvScaledResponseFiller, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        serveHistory(request, true);
     });
 
+    // Register JSON API: latest values with metadata
+    mvp.net.netWeb.registerFillerPage("/api" + uri, std::bind(&XmoduleSensor::serveApiData, this, std::placeholders::_1));
+
     // Register websocket and MQTT
-    webSocketPrint = mvp.net.netWeb.registerWebSocket("/wssensor", std::bind(&XmoduleSensor::networkCtrlCallback, this, std::placeholders::_1));
+    webSocketPrint = mvp.net.netWeb.registerWebSocket("/wssensor", std::bind(&XmoduleSensor::webSocketCtrlCallback, this, std::placeholders::_1, std::placeholders::_2));
+    webSocket = mvp.net.netWeb.getWebSocket("/wssensor");
+    webSocket->setBackpressure(cfgXmoduleSensor.webSocketQueueLimit, cfgXmoduleSensor.webSocketOverflow);
+    eventSource = mvp.net.netWeb.registerEventSource(uri + "events", "data", std::bind(&XmoduleSensor::replayEvent, this, std::placeholders::_1, std::placeholders::_2));
+    eventSource->setBackpressure(cfgXmoduleSensor.webSocketQueueLimit, cfgXmoduleSensor.webSocketOverflow);
     mqttPrint = mvp.net.netMqtt.registerMqtt("sensor", std::bind(&XmoduleSensor::networkCtrlCallback, this, std::placeholders::_1));
+
+    // Register metrics
+    mvp.metrics.addCounter("sensor_samples_total", "Samples added by the user script.", [&]() { return dataCollection.countSamples; });
+    mvp.metrics.addCounter("sensor_records_total", "Averaged records stored.", [&]() { return dataCollection.linkedListSensor.nextSeq; });
+    mvp.metrics.addCounter("sensor_records_evicted_total", "Records removed from the full data store.", [&]() { return dataCollection.linkedListSensor.countEvicted; });
+    mvp.metrics.addGauge("sensor_records_stored", "Records in the data store.", [&]() { return dataCollection.linkedListSensor.getSize(); });
+    mvp.metrics.addGauge("sensor_websocket_clients", "Connected websocket clients.", [&]() { return webSocket->getClientCount(); });
+    mvp.metrics.addCounter("sensor_websocket_dropped_total", "Messages not sent to slow websocket clients.", [&]() { return webSocket->countDropped; });
+    mvp.metrics.addGauge("sensor_event_clients", "Connected event stream clients.", [&]() { return eventSource->getClientCount(); });
+    mvp.metrics.addCounter("sensor_event_dropped_total", "Messages not sent to slow event stream clients.", [&]() { return eventSource->countDropped; });
+    mvp.metrics.addCounter("sensor_serial_frames_total", "Binary frames written to serial.", [&]() { return serialFrame.countFrames; });
+}
+
+void XmoduleSensor::firstSampleAdded() {
+    mvp.bootProfile.milestone(BootProfile::FIRST_SAMPLE);
 }
 
 void XmoduleSensor::loop() {
+    // Changed settings are saved from the network task, flushing Serial there would block it
+    if (serialBaudPending) {
+        serialBaudPending = false;
+        applySerialBaud();
+    }
+
     // Check flag if there is something to do
     if (!dataCollection.avgCycleFinished)
         return;
@@ -97,12 +133,45 @@ void XmoduleSensor::loop() {
     if (sensorTimer.justFinished()) {
 
         // Output data to serial, websocket, MQTT
-        mvp.logger.write(CfgLogger::Level::DATA, dataCollection.linkedListSensor.getLatestAsCsvNoTime(cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing).c_str() );
-        webSocketPrint(dataCollection.linkedListSensor.getLatestAsCsv(cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing));
-        mqttPrint(dataCollection.linkedListSensor.getLatestAsCsv(cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing));
+        // The output is written to buffers re-used for every measurement, websocket and MQTT copy what they need
+        // Binary frames go to serial directly, log text in between is separated by the zero delimiters
+        // Skip building the serial CSV if the data level is off
+        if (cfgXmoduleSensor.serialOutput == CfgXmoduleSensor::SerialOutput::SERIAL_BINARY) {
+            size_t frameLength = dataCollection.linkedListSensor.latestToSerialFrame(serialFrame, cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing);
+            Serial.write(serialFrame.getFrame(), frameLength);
+        } else if ((CfgLogger::Level::DATA <= MVP3000_LOG_LEVEL) && mvp.logger.isEnabled(CfgLogger::Subsystem::SENSOR, CfgLogger::Level::DATA)) {
+            dataCollection.linkedListSensor.latestToCsvBuffer(cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing, false);
+            mvp.logger.write(CfgLogger::Level::DATA, dataCollection.linkedListSensor.csvBuffer);
+        }
+        if (cfgXmoduleSensor.outputEncoding == CfgXmoduleSensor::OutputEncoding::CSV) {
+            size_t csvLength = dataCollection.linkedListSensor.latestToCsvBuffer(cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing);
+            webSocketPrint(dataCollection.linkedListSensor.csvBuffer);
+            mqttPrint(dataCollection.linkedListSensor.csvBuffer, csvLength);
+        } else {
+            size_t cborLength = dataCollection.linkedListSensor.latestToCborBuffer(cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing, (cfgXmoduleSensor.outputEncoding == CfgXmoduleSensor::OutputEncoding::CBOR_DELTA));
+            webSocket->binaryAll(dataCollection.linkedListSensor.cborBuffer, cborLength);
+            mqttPrint((const char*)dataCollection.linkedListSensor.cborBuffer, cborLength);
+        }
+        // Event stream is always CSV, the event id is the sequence number plus one as 0 means none
+        if (eventSource->hasClients()) {
+            dataCollection.linkedListSensor.latestToCsvBuffer(cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing);
+            eventSource->sendAll(dataCollection.linkedListSensor.csvBuffer, dataCollection.linkedListSensor.getNewestData()->seq + 1);
+        }
+        // Clients with a subscription only get what they asked for
+        sendWebSocketSubscriptions();
    }
 }
 
+uint32_t XmoduleSensor::replayEvent(uint32_t lastId, const char*& message) {
+    // Event id lastId is sequence number lastId - 1, the next one is lastId
+    DataCollection::LinkedListSensor::Node* node = dataCollection.linkedListSensor.findBySeq(lastId);
+    if (node == nullptr)
+        return 0;
+    dataCollection.linkedListSensor.nodeToCsvBuffer(node, cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing);
+    message = dataCollection.linkedListSensor.csvBuffer;
+    return node->dataStruct->seq + 1;
+}
+
 
 //////////////////////////////////////////////////////////////////////////////////
 
@@ -117,7 +186,7 @@ void XmoduleSensor::measureOffset() {
     dataCollection.setAveragingCountPtr(&cfgXmoduleSensor.averagingOffsetScaling);
 
     offsetRunning = true;
-    mvp.logger.write(CfgLogger::Level::INFO, "Offset measurement started.");
+    MVP3000_LOG(SENSOR, INFO, "Offset measurement started.");
 }
 
 bool XmoduleSensor::measureScaling(uint8_t valueNumber, int32_t targetValue) {
@@ -126,7 +195,7 @@ bool XmoduleSensor::measureScaling(uint8_t valueNumber, int32_t targetValue) {
 
     // Numbering starts from 1 in the real world!
     if ((valueNumber == 0) || (valueNumber > cfgXmoduleSensor.dataValueCount)) {
-        mvp.logger.writeFormatted(CfgLogger::Level::WARNING, "Scaling measurement valueNumber out of bounds.");
+        MVP3000_LOGF(SENSOR, WARNING, "Scaling measurement valueNumber out of bounds.");
         return false;
     }
     // Set target, convert real-world number to index
@@ -139,7 +208,7 @@ bool XmoduleSensor::measureScaling(uint8_t valueNumber, int32_t targetValue) {
     dataCollection.setAveragingCountPtr(&cfgXmoduleSensor.averagingOffsetScaling);
 
     scalingRunning = true;
-    mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Scaling measurement of index %d started.", scalingValueIndex);
+    MVP3000_LOGF(SENSOR, INFO, "Scaling measurement of index %d started.", scalingValueIndex);
     return true;
 }
 
@@ -150,7 +219,7 @@ void XmoduleSensor::measureOffsetScalingFinish() {
     } else if (scalingRunning) {
         dataCollection.processing.setScaling(dataCollection.linkedListSensor.getNewestData()->values);
     } else {
-        mvp.logger.write(CfgLogger::Level::ERROR, "Offset/Scaling measurement finished without running.");
+        MVP3000_LOG(SENSOR, ERROR, "Offset/Scaling measurement finished without running.");
         return;
     }
     offsetRunning = false;
@@ -158,7 +227,7 @@ void XmoduleSensor::measureOffsetScalingFinish() {
 
     // Save
     mvp.config.writeCfg(dataCollection.processing);
-    mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Offset/Scaling measurement done in %d ms.", millis() - dataCollection.avgStartTime );
+    MVP3000_LOGF(SENSOR, INFO, "Offset/Scaling measurement done in %d ms.", millis() - dataCollection.avgStartTime );
 
     // Restart data collection with new averaging
     clearTare();
@@ -191,20 +260,205 @@ void XmoduleSensor::setTare() {
 
 //////////////////////////////////////////////////////////////////////////////////
 
+void XmoduleSensor::sendWebSocketSubscriptions() {
+    // Subscriptions are changed by the websocket callbacks, they hold the same lock
+    webSocket->lockClients();
+    for (WebSocketSubscription& subscription : webSocketSubscriptions) {
+        if (subscription.clientId == 0)
+            continue;
+        if (++subscription.counter < subscription.decimation)
+            continue;
+        if ((subscription.minInterval_ms > 0) && (millis() - subscription.lastSent_ms < subscription.minInterval_ms))
+            continue;
+        subscription.counter = 0;
+        subscription.lastSent_ms = millis();
+
+        boolean connected;
+        if (subscription.encoding == CfgXmoduleSensor::OutputEncoding::CSV) {
+            size_t csvLength = dataCollection.linkedListSensor.latestToCsvBuffer(cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing, true, &subscription.channelMask);
+            connected = webSocket->sendClient(subscription.clientId, (const uint8_t*)dataCollection.linkedListSensor.csvBuffer, csvLength, false);
+        } else {
+            size_t cborLength = dataCollection.linkedListSensor.latestToCborBuffer(cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing, (subscription.encoding == CfgXmoduleSensor::OutputEncoding::CBOR_DELTA), &subscription.channelMask);
+            connected = webSocket->sendClient(subscription.clientId, dataCollection.linkedListSensor.cborBuffer, cborLength, true);
+        }
+        // Free the subscription of a disconnected client
+        if (!connected)
+            subscription.clientId = 0;
+    }
+    webSocket->unlockClients();
+}
+
+void XmoduleSensor::webSocketSubscribe(char* data, uint32_t clientId) {
+    // SUB channels=1,5,6 decimation=10 maxrate=5 encoding=CBOR, all parameters are optional
+    // Channels are numbered from 1 as on the web page, maxrate is in Hz, encoding is CSV, CBOR, or CBOR_DELTA
+    // Parsed into a copy, the loop reads the subscriptions while this runs
+    WebSocketSubscription parsed;
+    WebSocketSubscription* subscription = &parsed;
+    subscription->encoding = cfgXmoduleSensor.outputEncoding;
+
+    boolean anyChannel = false;
+    char* saveToken;
+    for (char* token = strtok_r(data + 3, " ", &saveToken); token != nullptr; token = strtok_r(nullptr, " ", &saveToken)) {
+        char* value = strchr(token, '=');
+        if (value == nullptr)
+            continue;
+        *value++ = '\0';
+
+        if (strcmp(token, "channels") == 0) {
+            anyChannel = subscription->channelMask.parse(value, cfgXmoduleSensor.dataValueCount);
+        } else if (strcmp(token, "decimation") == 0) {
+            subscription->decimation = constrain(atoi(value), 1, 65535);
+        } else if (strcmp(token, "maxrate") == 0) {
+            float rate = atof(value);
+            subscription->minInterval_ms = (rate > 0) ? constrain(1000 / rate, 0, 65535) : 0;
+        } else if (strcmp(token, "encoding") == 0) {
+            if (strcmp(value, "CSV") == 0)
+                subscription->encoding = CfgXmoduleSensor::OutputEncoding::CSV;
+            else if (strcmp(value, "CBOR") == 0)
+                subscription->encoding = CfgXmoduleSensor::OutputEncoding::CBOR;
+            else if (strcmp(value, "CBOR_DELTA") == 0)
+                subscription->encoding = CfgXmoduleSensor::OutputEncoding::CBOR_DELTA;
+        }
+    }
+    if (!anyChannel) {
+        for (uint8_t i = 0; i < cfgXmoduleSensor.dataValueCount; i++)
+            subscription->channelMask.set(i);
+    }
+
+    subscription->clientId = clientId;
+
+    webSocket->lockClients();
+    subscription = nullptr;
+    for (WebSocketSubscription& current : webSocketSubscriptions) {
+        if ((current.clientId == clientId) || ((subscription == nullptr) && (current.clientId == 0)))
+            subscription = &current;
+    }
+    if (subscription != nullptr) {
+        *subscription = parsed;
+        webSocket->setDirectOnly(clientId, true);
+    }
+    webSocket->unlockClients();
+
+    if (subscription == nullptr) { // Not possible as there are as many subscriptions as clients
+        MVP3000_LOGF(SENSOR, WARNING, "WS client %lu subscription failed, no free slot.", (unsigned long)clientId);
+        return;
+    }
+    MVP3000_LOGF(SENSOR, CONTROL, "WS client %lu subscribed, decimation %d, interval %d ms.", (unsigned long)clientId, parsed.decimation, parsed.minInterval_ms);
+}
+
+void XmoduleSensor::webSocketUnsubscribe(uint32_t clientId) {
+    webSocket->lockClients();
+    for (WebSocketSubscription& subscription : webSocketSubscriptions) {
+        if (subscription.clientId == clientId)
+            subscription.clientId = 0;
+    }
+    webSocket->setDirectOnly(clientId, false);
+    webSocket->unlockClients();
+    MVP3000_LOGF(SENSOR, CONTROL, "WS client %lu unsubscribed.", (unsigned long)clientId);
+}
+
+void XmoduleSensor::saveCfgCallback() {
+    webSocket->setBackpressure(cfgXmoduleSensor.webSocketQueueLimit, cfgXmoduleSensor.webSocketOverflow);
+    eventSource->setBackpressure(cfgXmoduleSensor.webSocketQueueLimit, cfgXmoduleSensor.webSocketOverflow);
+    serialBaudPending = true;
+}
+
+void XmoduleSensor::applySerialBaud() {
+    // Let pending output leave at the old rate, the log ring keeps everything newer
+    Serial.flush();
+    Serial.begin(cfgXmoduleSensor.serialBaudRates[cfgXmoduleSensor.serialBaud]);
+}
+
+void XmoduleSensor::webSocketCtrlCallback(char* data, uint32_t clientId) {
+    // Subscriptions are per websocket client, everything else is shared with MQTT
+    if ((strncmp(data, "SUB", 3) == 0) && ((data[3] == ' ') || (data[3] == '\0'))) {
+        webSocketSubscribe(data, clientId);
+    } else if (strcmp(data, "UNSUB") == 0) {
+        webSocketUnsubscribe(clientId);
+    } else {
+        networkCtrlCallback(data);
+    }
+}
+
 void XmoduleSensor::networkCtrlCallback(char* data) {
     // data can be 'TARE' or 'CLEAR'
     if (strcmp(data, "TARE") == 0) {
         setTare();
-        mvp.logger.write(CfgLogger::Level::CONTROL, "Set Tare.");
+        MVP3000_LOG(SENSOR, CONTROL, "Set Tare.");
     } else if (strcmp(data, "CLEAR") == 0) {
         clearTare();
-        mvp.logger.write(CfgLogger::Level::CONTROL, "Clear Tare.");
+        MVP3000_LOG(SENSOR, CONTROL, "Clear Tare.");
     } else {
-        mvp.logger.writeFormatted(CfgLogger::Level::CONTROL, "Unknown command '%s' received.", data);
+        MVP3000_LOGF(SENSOR, CONTROL, "Unknown command '%s' received.", data);
     }
 }
 
 
+void XmoduleSensor::serveApiData(AsyncWebServerRequest *request) {
+    mvp.net.netWeb.sendJsonResponse(request, [&](JsonWriter& json) {
+        json.beginObject();
+        json.writeText("name", cfgXmoduleSensor.infoName);
+        json.writeText("description", cfgXmoduleSensor.infoDescription);
+        json.writeUint("columns", min(cfgXmoduleSensor.matrixColumnCount, cfgXmoduleSensor.dataValueCount));
+        json.writeUint("stored", dataCollection.linkedListSensor.getSize());
+
+        // Values are integers, the physical value is value / 10^exponent
+        json.writeKey("channels");
+        json.beginArray();
+        for (uint8_t i = 0; i < cfgXmoduleSensor.dataValueCount; i++) {
+            json.beginObject();
+            json.writeText("type", cfgXmoduleSensor.sensorTypes[i]);
+            json.writeText("unit", cfgXmoduleSensor.sensorUnits[i]);
+            json.writeInt("offset", dataCollection.processing.offset.values[i]);
+            json.writeFloat("scaling", dataCollection.processing.scaling.values[i], 4);
+            json.writeInt("exponent", dataCollection.processing.sampleToIntExponent.values[i]);
+            json.endObject();
+        }
+        json.endArray();
+
+        json.writeKey("latest");
+        if (dataCollection.linkedListSensor.getSize() == 0) {
+            json.writeNull();
+        } else {
+            DataCollection::DataStructSensor* latest = dataCollection.linkedListSensor.getNewestData();
+            json.beginObject();
+            json.writeUint("seq", latest->seq);
+            json.writeUint("time", latest->time);
+            json.writeKey("raw");
+            json.beginArray();
+            for (uint8_t i = 0; i < latest->value_size; i++)
+                json.writeInt(latest->values[i]);
+            json.endArray();
+            json.writeKey("scaled");
+            json.beginArray();
+            for (uint8_t i = 0; i < latest->value_size; i++)
+                json.writeInt(dataCollection.processing.applyProcessing(latest->values[i], i));
+            json.endArray();
+            json.endObject();
+        }
+        json.endObject();
+    });
+}
+
+boolean XmoduleSensor::webPageListProcessor(uint8_t var, uint16_t index, String& row) {
+    switch (var) {
+        case 120: // Sensor details: type, unit, offset, scaling, float to int exponent
+            if (index >= cfgXmoduleSensor.dataValueCount)
+                return false;
+            {
+                StringBuffer<160> line;
+                line.append("<tr> <td>").appendUint(index + 1).append("</td> <td>").append(cfgXmoduleSensor.sensorTypes[index]).append("</td> <td>").append(cfgXmoduleSensor.sensorUnits[index]);
+                line.append("</td> <td>").appendInt(dataCollection.processing.offset.values[index]).append("</td> <td>").appendFloat(dataCollection.processing.scaling.values[index], 2);
+                line.append("</td> <td>").appendInt(dataCollection.processing.sampleToIntExponent.values[index]).append("</td> </tr> ");
+                row = line.c_str();
+            }
+            return true;
+
+        default:
+            return false;
+    }
+}
+
 String XmoduleSensor::webPageProcessor(uint8_t var) {
     switch (var) {
         case 101:
@@ -221,17 +475,36 @@ String XmoduleSensor::webPageProcessor(uint8_t var) {
         case 113:
             return String(cfgXmoduleSensor.reportingInterval);
         case 114:
-            return _helper.printFormatted("%d / %d (%s)", dataCollection.linkedListSensor.getSize(), dataCollection.linkedListSensor.getMaxSize(), (dataCollection.linkedListSensor.isAdaptive() ? "adaptive" : "fixed"));
+            {
+                StringBuffer<40> text;
+                text.appendUint(dataCollection.linkedListSensor.getSize()).append(" / ").appendUint(dataCollection.linkedListSensor.getMaxSize());
+                text.append(dataCollection.linkedListSensor.isAdaptive() ? " (adaptive)" : " (fixed)");
+                return text.c_str();
+            }
         case 115:
             return String(cfgXmoduleSensor.dataValueCount);
+        case 116 ... 118: // Output encoding select
+            return (cfgXmoduleSensor.outputEncoding == var - 116) ? "selected" : "";
+        case 119: { // Websocket client statistics
+            StringBuffer<640> text; // Up to four clients each
+            auto appendClient = [&](const char* prefix, WebSocketClientStats* client) {
+                text.append(prefix).appendUint(client->id).append(": ").appendUint(client->countQueued).append(" / ").appendUint(client->countDropped).append(" / ").appendUint(client->bytes).append("</li>");
+            };
+            webSocket->loopClients([&](WebSocketClientStats* client) { appendClient("<li>#", client); });
+            eventSource->loopClients([&](WebSocketClientStats* client) { appendClient("<li>Event #", client); });
+            return (text.length() > 0) ? text.c_str() : "<li>-</li>";
+        }
 
-        case 120: // Split the long string into multiple rows                   // TODO why not using the bookmark in the linked list ???
-            webPageProcessorIndex = 0;
-        case 121:
-            // Sensor details: type, unit, offset, scaling, float to int exponent - placeholder for next row
-            return _helper.printFormatted("<tr> <td>%d</td> <td>%s</td> <td>%s</td> <td>%d</td> <td>%.2f</td> <td>%d</td> </tr> %s",
-                webPageProcessorIndex+1, cfgXmoduleSensor.sensorTypes[webPageProcessorIndex], cfgXmoduleSensor.sensorUnits[webPageProcessorIndex], dataCollection.processing.offset.values[webPageProcessorIndex], dataCollection.processing.scaling.values[webPageProcessorIndex], dataCollection.processing.sampleToIntExponent.values[webPageProcessorIndex],
-                (webPageProcessorIndex++ < cfgXmoduleSensor.dataValueCount - 1) ? "%121%" : "");
+        case 122:
+            return String(cfgXmoduleSensor.webSocketQueueLimit);
+        case 123 ... 124: // Websocket overflow select
+            return (cfgXmoduleSensor.webSocketOverflow == var - 123) ? "selected" : "";
+        case 125 ... 126: // Serial output select
+            return (cfgXmoduleSensor.serialOutput == var - 125) ? "selected" : "";
+        case 127 ... 132: // Serial baud rate select
+            return (cfgXmoduleSensor.serialBaud == var - 127) ? "selected" : "";
+        case 133:
+            return String(serialFrame.countFrames);
 
         default:
             return "";
@@ -244,16 +517,81 @@ size_t XmoduleSensor::csvLastestResponseFiller(uint8_t *buffer, size_t maxLen, s
     });
 }
 
-size_t XmoduleSensor::csvRawResponseFiller(uint8_t *buffer, size_t maxLen, size_t index) {
-    return csvExtendedResponseFiller(buffer, maxLen, index, false, [&]() -> String {
-        return dataCollection.linkedListSensor.getBookmarkAsCsv(cfgXmoduleSensor.matrixColumnCount, nullptr);
+void XmoduleSensor::serveHistory(AsyncWebServerRequest *request, boolean scaled) {
+    // The query is owned by the filler and released with the response
+    std::shared_ptr<SensorHistoryQuery> query = std::make_shared<SensorHistoryQuery>();
+    query->scaled = scaled;
+
+    DataCollection::LinkedListSensor& list = dataCollection.linkedListSensor;
+    if (list.getSize() > 0) {
+        query->nextSeq = list.getOldestData()->seq;
+        query->lastSeq = list.getNewestData()->seq;
+    }
+
+    // since: sequence number of the last record already received, sinceTime: time of it in ms, boot: X-Boot of that response
+    // Sequence numbers and time start over after a reboot, a position from another boot or beyond the newest record means from the start
+    boolean sameBoot = !request->hasParam("boot") || (strtoul(request->getParam("boot")->value().c_str(), nullptr, 10) == bootId);
+    if (sameBoot && request->hasParam("since")) {
+        uint32_t since = strtoul(request->getParam("since")->value().c_str(), nullptr, 10);
+        if (since < list.nextSeq)
+            query->nextSeq = max(query->nextSeq, since + 1);
+    } else if (sameBoot && request->hasParam("sinceTime")) {
+        DataCollection::LinkedListSensor::Node* node = list.findAfterTime(strtoull(request->getParam("sinceTime")->value().c_str(), nullptr, 10));
+        query->nextSeq = (node != nullptr) ? node->dataStruct->seq : query->lastSeq + 1;
+    }
+    if (request->hasParam("limit"))
+        query->remaining = constrain(request->getParam("limit")->value().toInt(), 0, 65535);
+    if (request->hasParam("step"))
+        query->step = constrain(request->getParam("step")->value().toInt(), 1, 65535);
+    if (request->hasParam("channels")) {
+        String channels = request->getParam("channels")->value();
+        query->useMask = query->channelMask.parse((char*)channels.c_str(), cfgXmoduleSensor.dataValueCount);
+    }
+
+    // The last record that will be sent is known now, clients pass it as since in the next poll
+    uint32_t lastSent = query->nextSeq - 1;
+    if ((list.getSize() > 0) && (query->remaining > 0) && (query->nextSeq <= query->lastSeq)) {
+        uint32_t count = min((uint32_t)query->remaining, (query->lastSeq - query->nextSeq) / query->step + 1);
+        lastSent = query->nextSeq + (count - 1) * query->step;
+    }
+
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/octet-stream", [this, query](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        return csvHistoryResponseFiller(query.get(), buffer, maxLen);
     });
+    response->addHeader("X-Last-Seq", String(lastSent));
+    response->addHeader("X-Boot", String(bootId));
+    request->send(response);
 }
 
-size_t XmoduleSensor::csvScaledResponseFiller(uint8_t *buffer, size_t maxLen, size_t index) {
-    return csvExtendedResponseFiller(buffer, maxLen, index, false, [&]() -> String {
-        return dataCollection.linkedListSensor.getBookmarkAsCsv(cfgXmoduleSensor.matrixColumnCount, &dataCollection.processing);
-    });
+size_t XmoduleSensor::csvHistoryResponseFiller(SensorHistoryQuery* query, uint8_t* buffer, size_t maxLen) {
+    if ((query->remaining == 0) || (query->nextSeq > query->lastSeq))
+        return 0;
+
+    // Records removed since the last chunk are skipped, within the chunk the list is walked directly
+    DataCollection::LinkedListSensor& list = dataCollection.linkedListSensor;
+    DataCollection::LinkedListSensor::Node* node = list.findBySeq(query->nextSeq);
+
+    size_t pos = 0;
+    while ((node != nullptr) && (query->remaining > 0) && (node->dataStruct->seq <= query->lastSeq)) {
+        size_t len = list.nodeToCsvBuffer(node, cfgXmoduleSensor.matrixColumnCount, (query->scaled) ? &dataCollection.processing : nullptr, true, (query->useMask) ? &query->channelMask : nullptr);
+        if (pos + len + 1 > maxLen) {
+            // WORKAROUND as for the latest data: the buffer is often just a few bytes long, a single space indicates there is more data
+            if ((pos == 0) && (maxLen > 0))
+                buffer[pos++] = ' ';
+            break;
+        }
+        memcpy(buffer + pos, list.csvBuffer, len);
+        pos += len;
+        buffer[pos++] = '\n';
+
+        query->remaining--;
+        query->nextSeq = node->dataStruct->seq + query->step;
+        for (uint16_t i = 0; (i < query->step) && (node != nullptr); i++)
+            node = node->next;
+    }
+    if (node == nullptr)
+        query->nextSeq = query->lastSeq + 1; // Done, also if the list was cleared
+    return pos;
 }
 
 size_t XmoduleSensor::csvExtendedResponseFiller(uint8_t* buffer, size_t maxLen, size_t index, boolean firstOnly, std::function<String()> stringFunc) {
@@ -287,7 +625,7 @@ size_t XmoduleSensor::csvExtendedResponseFiller(uint8_t* buffer, size_t maxLen,
                 // Well, this should not happen, buffer full even before the first iteration of the loop
                 // But it does! The buffer is often just a few (<10) bytes long
                 // This is actually so common, it is not even worth an info message
-                // mvp.logger.writeFormatted(CfgLogger::Level::INFO, "Web-CSV buffer too small for data: %d < %d.", maxLen, strLen);
+                // MVP3000_LOGF(SENSOR, INFO, "Web-CSV buffer too small for data: %d < %d.", maxLen, strLen);
                 // WORKAROUND: Return a single space to indicate there is more data. The next buffer will likely be larger.
                 if (maxLen > 0) {
                     memcpy(buffer, " ", 1);
@@ -24,8 +24,10 @@ limitations under the License.
 #include "_Xmodule.h"
 
 #include "_Helper_LimitTimer.h"
+#include "NetWeb_WebStructs.h"
 
 #include "XmoduleSensor_DataCollection.h"
+#include "XmoduleSensor_SerialFrame.h"
 
 
 struct CfgXmoduleSensor : CfgJsonInterface {
@@ -36,10 +38,33 @@ struct CfgXmoduleSensor : CfgJsonInterface {
     uint16_t averagingOffsetScaling = 25;
     uint16_t reportingInterval = 0; // [ms], set to 0 to ignore
 
+    enum OutputEncoding: uint8_t {
+        CSV = 0, // Text, time;values
+        CBOR = 1, // Binary map with sequence number, time, column count and values
+        CBOR_DELTA = 2 // Same but values are delta encoded
+    };
+    uint16_t outputEncoding = OutputEncoding::CSV; // Websocket and MQTT, serial output is always CSV
+
+    uint16_t webSocketQueueLimit = 8; // Messages queued per websocket client
+    uint16_t webSocketOverflow = 0; // 0: coalesce to latest, 1: disconnect client
+
+    enum SerialOutput: uint8_t {
+        SERIAL_TEXT = 0, // CSV in the log at data level
+        SERIAL_BINARY = 1 // COBS framed binary records, see XmoduleSensor_SerialFrame.h
+    };
+    uint16_t serialOutput = SerialOutput::SERIAL_TEXT;
+    uint16_t serialBaud = 0; // Index of the baud rate, applies to the log output as well
+    const uint32_t serialBaudRates[6] = { 115200, 230400, 460800, 921600, 1500000, 2000000 };
+
     CfgXmoduleSensor() : CfgJsonInterface("cfgXmoduleSensor") {
         addSetting<uint16_t>("sampleAveraging", &sampleAveraging, [](uint16_t x) { return (x == 0) ? false : true; }); // at least 1
         addSetting<uint16_t>("averagingOffsetScaling", &averagingOffsetScaling, [](uint16_t x) { return (x == 0) ? false : true; }); // at least 1
         addSetting<uint16_t>("reportingInterval", &reportingInterval, [](uint16_t _) { return true; });
+        addSetting<uint16_t>("outputEncoding", &outputEncoding, [](uint16_t x) { return (x > 2) ? false : true; });
+        addSetting<uint16_t>("webSocketQueueLimit", &webSocketQueueLimit, [](uint16_t x) { return ((x == 0) || (x > 32)) ? false : true; }); // 1-32
+        addSetting<uint16_t>("webSocketOverflow", &webSocketOverflow, [](uint16_t x) { return (x > 1) ? false : true; });
+        addSetting<uint16_t>("serialOutput", &serialOutput, [](uint16_t x) { return (x > 1) ? false : true; });
+        addSetting<uint16_t>("serialBaud", &serialBaud, [](uint16_t x) { return (x > 5) ? false : true; });
     };
 
     // Settings that are not known during creation of this config within the framework but need init before anything works
@@ -86,6 +111,37 @@ struct CfgXmoduleSensor : CfgJsonInterface {
 };
 
 
+//////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Data stream a websocket client subscribed to: selected channels, decimation or maximum rate, and encoding.
+ */
+struct WebSocketSubscription {
+    uint32_t clientId = 0; // 0 is unused
+    DataCollection::ChannelMask channelMask;
+    uint16_t decimation = 1; // Send every n-th measurement
+    uint16_t minInterval_ms = 0; // From the maximum rate, 0 to ignore
+    uint8_t encoding = CfgXmoduleSensor::OutputEncoding::CSV;
+
+    uint16_t counter = 0;
+    uint32_t lastSent_ms = 0;
+};
+
+
+/**
+ * @brief Per-request state of a stored data download: next and last record, records left, step, and channels.
+ */
+struct SensorHistoryQuery {
+    uint32_t nextSeq = 0;
+    uint32_t lastSeq = 0; // Newest record when the request started, newer ones are for the next poll
+    uint16_t remaining = std::numeric_limits<uint16_t>::max(); // Limit of records
+    uint16_t step = 1; // Send every n-th record
+    boolean useMask = false;
+    DataCollection::ChannelMask channelMask;
+    boolean scaled = false;
+};
+
+
 //////////////////////////////////////////////////////////////////////////////////
 
 class XmoduleSensor : public _Xmodule {
@@ -100,6 +156,7 @@ class XmoduleSensor : public _Xmodule {
         XmoduleSensor(uint8_t valueCount) : _Xmodule("Sensor Module", "/sensor") {
             cfgXmoduleSensor.initValueCount(valueCount);
             dataCollection.initDataValueSize(valueCount); // Averaging can change during operation
+            serialFrame.init(valueCount);
         };
 
         /**
@@ -112,6 +169,8 @@ class XmoduleSensor : public _Xmodule {
         void addSample(T *newSample)  {
             // This just adds the sample to the data collection for averaging, once count is done further work is done in the Loop()
             dataCollection.addSampleNEW(newSample);
+            if (dataCollection.countSamples == 1)
+                firstSampleAdded();
         };
 
         /**
@@ -176,6 +235,10 @@ class XmoduleSensor : public _Xmodule {
 
         LimitTimer sensorTimer = LimitTimer(0);
 
+        SerialFrameWriter serialFrame; // Re-used for every binary serial record
+        boolean serialBaudPending = false; // Set by the settings callback, Serial is only touched from the loop
+        void applySerialBaud();
+
         // Offset and scaling
         boolean offsetRunning = false;
         boolean scalingRunning = false;
@@ -184,16 +247,31 @@ class XmoduleSensor : public _Xmodule {
 
         void measureOffsetScalingFinish();
 
+        void firstSampleAdded(); // Boot profile
+
+        void saveCfgCallback();
         void networkCtrlCallback(char* data); // Callback for to receive control commands from MQTT and websocket
-        std::function<void(const String& message)> mqttPrint; // Function to print to the MQTT topic
+        void webSocketCtrlCallback(char* data, uint32_t clientId); // Adds stream subscriptions to the control commands
+        std::function<void(const char* message, size_t length)> mqttPrint; // Function to print to the MQTT topic
         std::function<void(const String& message)> webSocketPrint; // Function to print to the websocket
+        DataStructWebSocket* webSocket; // To write binary data, apply backpressure settings, and read client statistics
+        DataStructEventSource* eventSource; // CSV as server-sent events, same limits as the websocket
+        uint32_t replayEvent(uint32_t lastId, const char*& message);
+
+        WebSocketSubscription webSocketSubscriptions[DataStructWebSocket::MAX_CLIENTS];
+        void webSocketSubscribe(char* data, uint32_t clientId);
+        void webSocketUnsubscribe(uint32_t clientId);
+        void sendWebSocketSubscriptions();
 
         String webPageProcessor(uint8_t var);
-        uint8_t webPageProcessorIndex;
+        boolean webPageListProcessor(uint8_t var, uint16_t index, String& row) override;
+
+        void serveApiData(AsyncWebServerRequest *request);
 
-        size_t csvRawResponseFiller(uint8_t* buffer, size_t maxLen, size_t index);
+        uint32_t bootId = 0; // Random per boot, sequence numbers start over after a reboot
+        void serveHistory(AsyncWebServerRequest *request, boolean scaled);
+        size_t csvHistoryResponseFiller(SensorHistoryQuery* query, uint8_t* buffer, size_t maxLen);
         size_t csvLastestResponseFiller(uint8_t* buffer, size_t maxLen, size_t index);
-        size_t csvScaledResponseFiller(uint8_t* buffer, size_t maxLen, size_t index);
         size_t csvExtendedResponseFiller(uint8_t* buffer, size_t maxLen, size_t index, boolean firstOnly, std::function<String()> stringFunc);
 
         const char*  getWebPage() override { return R"===(%0%
@@ -208,7 +286,16 @@ class XmoduleSensor : public _Xmodule {
 <li>Data storage: %114%</li>
 <li>Current data: <a href='/sensordata'>/sensordata</a> </li>
 <li>Live websocket: ws://%2%/wssensor </li>
+<li>Live event stream: http://%2%/sensorevents </li>
+<li>Websocket messages queued per client: <br> <form action='/save' method='post'> <input name='webSocketQueueLimit' value='%122%' type='number' min='1' max='32'> <input type='submit' value='Save'> </form> </li>
+<li>Websocket client too slow: <br> <form action='/save' method='post'> <select name='webSocketOverflow'> <option value='0' %123%>Coalesce to latest</option> <option value='1' %124%>Disconnect</option> </select> <input type='submit' value='Save'> </form> </li>
+<li>Websocket and event stream clients, queued / dropped / bytes: <ul> %119% </ul> </li>
+<li>Websocket and MQTT encoding:<br> <form action='/save' method='post'> <select name='outputEncoding'> <option value='0' %116%>CSV</option> <option value='1' %117%>CBOR</option> <option value='2' %118%>CBOR, delta encoded values</option> </select> <input type='submit' value='Save'> </form> </li>
 <li>CSV data: <a href='/sensordatasscaled'>/sensordatasscaled</a>, <a href='/sensordatasraw'>/sensordatasraw</a> </li> </ul>
+<h3>Serial Output</h3> <ul>
+<li>Data on serial, binary frames are decoded with examples/serial/serial_decoder.py:<br> <form action='/save' method='post'> <select name='serialOutput'> <option value='0' %125%>CSV text in the log</option> <option value='1' %126%>Binary frames, COBS with CRC-32</option> </select> <input type='submit' value='Save'> </form> </li>
+<li>Baud rate, also used by the log:<br> <form action='/save' method='post'> <select name='serialBaud'> <option value='0' %127%>115200</option> <option value='1' %128%>230400</option> <option value='2' %129%>460800</option> <option value='3' %130%>921600</option> <option value='4' %131%>1500000</option> <option value='5' %132%>2000000</option> </select> <input type='submit' value='Save'> </form> </li>
+<li>Binary frames sent: %133%</li> </ul>
 <h3>Sensor Details</h3> <table>
 <tr> <td>#</td> <td>Type</td> <td>Unit</td> <td>Offset</td><td>Scaling</td><td>Float to Int exp. 10<sup>x</sup></td> </tr>
 %120%
@@ -17,6 +17,10 @@ limitations under the License.
 #ifndef MVP3000_XMODULESENSOR_DATACOLLECTION
 #define MVP3000_XMODULESENSOR_DATACOLLECTION
 
+#include "_Helper_CborWriter.h"
+#include "_Helper_StringBuilder.h"
+#include "XmoduleSensor_SerialFrame.h"
+
 #include "XmoduleSensor_DataCollection_NumberArray.h"
 #include "XmoduleSensor_DataProcessing.h"
 
@@ -24,19 +28,52 @@ limitations under the License.
 struct DataCollection {
 
     /**
-     * Data structure to store sensor data and its time.
+     * Data structure to store sensor data, its time and sequence number.
      */
     struct DataStructSensor : NumberArray<int32_t> {
         uint64_t time;
+        uint32_t seq;
 
         /**
          * @brief Constructor for data structure.
          *
          * @param _time Time of data
+         * @param _seq Sequence number of data, lets receivers detect gaps
          * @param _values Pointer to data array
          * @param _value_size Size of data array
          */
-        DataStructSensor(uint64_t _time, int32_t* _values, uint8_t _value_size) : NumberArray<int32_t>(_values, _value_size), time(_time) { }
+        DataStructSensor(uint64_t _time, uint32_t _seq, int32_t* _values, uint8_t _value_size) : NumberArray<int32_t>(_values, _value_size), time(_time), seq(_seq) { }
+    };
+
+    /**
+     * Selection of channels, for example for a client that needs only some of the values.
+     */
+    struct ChannelMask {
+        uint32_t bits[8] = { 0 }; // Enough for the maximum of 255 values
+
+        void clear() { memset(bits, 0, sizeof(bits)); }
+        void set(uint8_t i) { bits[i / 32] |= (1UL << (i % 32)); }
+        boolean isSet(uint8_t i) const { return bits[i / 32] & (1UL << (i % 32)); }
+
+        /**
+         * @brief Set the channels of a comma separated list, channels are numbered from 1 as on the web page.
+         *
+         * @param list The list, it is modified.
+         * @param valueCount Number of channels, larger numbers are ignored.
+         * @return False if no valid channel was in the list.
+         */
+        boolean parse(char* list, uint8_t valueCount) {
+            boolean anyChannel = false;
+            char* saveChannel;
+            for (char* channel = strtok_r(list, ",", &saveChannel); channel != nullptr; channel = strtok_r(nullptr, ",", &saveChannel)) {
+                int number = atoi(channel);
+                if ((number >= 1) && (number <= valueCount)) {
+                    set(number - 1);
+                    anyChannel = true;
+                }
+            }
+            return anyChannel;
+        }
     };
 
     /**
@@ -48,28 +85,180 @@ struct DataCollection {
         void append(uint64_t time, NumberArrayLateInit<int32_t> *data) {
             // Create data structure and add node to linked list
             // Using this-> as base class/function is templated
-            this->appendDataStruct(new DataStructSensor(time, data->values, data->value_size));
+            this->appendDataStruct(new DataStructSensor(time, nextSeq++, data->values, data->value_size));
         }
 
-        String getBookmarkAsCsv(uint8_t columnCount, DataProcessing *processing) { return nodeToCSV(bookmark, columnCount, processing); }
-        String getLatestAsCsv(uint8_t columnCount, DataProcessing *processing) { return nodeToCSV(tail, columnCount, processing); }
-        String getLatestAsCsvNoTime(uint8_t columnCount, DataProcessing *processing) { return nodeToCSV(tail, columnCount, processing, false); }
+        // Not reset when the list is cleared, receivers see the gap
+        uint32_t nextSeq = 0;
+
+        // Re-used for every CSV line, allocated once the number of values is known
+        char* csvBuffer = nullptr;
+        size_t csvBufferSize = 0;
+
+        // Re-used for every binary encoded measurement
+        uint8_t* cborBuffer = nullptr;
+        size_t cborBufferSize = 0;
+
+        ~LinkedListSensor() { delete[] csvBuffer; delete[] cborBuffer; }
+
+        void initOutputBuffers(uint8_t valueSize) {
+            // Time up to 10 digits plus separator, values up to 11 characters plus separator, termination
+            csvBufferSize = 11 + 12 * valueSize + 1;
+            delete[] csvBuffer;
+            csvBuffer = new char[csvBufferSize];
+            csvBuffer[0] = '\0';
+
+            // Map header, keys with seq, time, column count and array header, values up to 5 bytes also as delta
+            cborBufferSize = 24 + 5 * valueSize;
+            delete[] cborBuffer;
+            cborBuffer = new uint8_t[cborBufferSize];
+        }
+
+        String getLatestAsCsv(uint8_t columnCount, DataProcessing *processing) { nodeToCsvBuffer(tail, columnCount, processing); return csvBuffer; }
+
+        /**
+         * @brief Write the latest data as CSV to the buffer, it is valid until the next call.
+         *
+         * @param columnCount Number of values per row.
+         * @param processing Processing to apply to the values, nullptr for raw values.
+         * @param withTime Prepend the time of the data.
+         * @param mask (optional) Only output the selected channels, as a single row.
+         * @return Length of the CSV string in the buffer.
+         */
+        size_t latestToCsvBuffer(uint8_t columnCount, DataProcessing *processing, boolean withTime = true, const ChannelMask* mask = nullptr) { return nodeToCsvBuffer(tail, columnCount, processing, withTime, mask); }
+
+        /**
+         * @brief Write the latest data CBOR encoded to the buffer, it is valid until the next call.
+         *
+         * The map has the keys s (sequence number), t (time), c (column count) and either v (values) or d (delta encoded values).
+         * With delta encoding the first value is absolute and each following value is the difference to the one before.
+         *
+         * @param columnCount Number of values per row.
+         * @param processing Processing to apply to the values, nullptr for raw values.
+         * @param delta Encode the values as differences.
+         * @param mask (optional) Only output the selected channels, as a single row.
+         * @return Length of the encoded data in the buffer, 0 if there is no data.
+         */
+        size_t latestToCborBuffer(uint8_t columnCount, DataProcessing *processing, boolean delta, const ChannelMask* mask = nullptr) {
+            if ((cborBuffer == nullptr) || (tail == nullptr))
+                return 0;
+
+            DataStructSensor* data = tail->dataStruct;
+            uint8_t valueCount = data->value_size;
+            if (mask != nullptr) {
+                valueCount = 0;
+                for (uint8_t i = 0; i < data->value_size; i++)
+                    valueCount += mask->isSet(i);
+                columnCount = valueCount;
+            }
 
-        String nodeToCSV(Node* node, uint8_t columnCount, DataProcessing *processing, boolean withTime = true) {
-            // Return emty string if node is empty
-            if (node == nullptr) {
-                return "";
+            CborWriter cbor(cborBuffer, cborBufferSize);
+            cbor.writeMapHeader(4);
+            cbor.writeText("s");
+            cbor.writeUint(data->seq);
+            cbor.writeText("t");
+            cbor.writeUint(data->time);
+            cbor.writeText("c");
+            cbor.writeUint(min(columnCount, valueCount));
+            cbor.writeText(delta ? "d" : "v");
+            cbor.writeArrayHeader(valueCount);
+            int64_t previous = 0;
+            for (uint8_t i = 0; i < data->value_size; i++) {
+                if ((mask != nullptr) && !mask->isSet(i))
+                    continue;
+                int32_t value = (processing == nullptr) ? data->values[i] : processing->applyProcessing(data->values[i], i);
+                cbor.writeInt(delta ? value - previous : value);
+                previous = value;
             }
-            String str;
-            if (withTime) {
-                str += String(node->dataStruct->time);
-                str += ";";
+            return (cbor.overflow) ? 0 : cbor.length;
+        }
+
+        /**
+         * @brief Write the latest data as binary serial frame, it is valid until the next call.
+         *
+         * @param serialFrame The frame writer with its buffers.
+         * @param columnCount Number of values per row.
+         * @param processing Processing to apply to the values, nullptr for raw values.
+         * @return Length of the encoded frame, 0 if there is no data.
+         */
+        size_t latestToSerialFrame(SerialFrameWriter& serialFrame, uint8_t columnCount, DataProcessing *processing) {
+            if (tail == nullptr)
+                return 0;
+
+            DataStructSensor* data = tail->dataStruct;
+            serialFrame.begin(data->seq, data->time, min(columnCount, data->value_size), data->value_size);
+            for (uint8_t i = 0; i < data->value_size; i++)
+                serialFrame.addValue((processing == nullptr) ? data->values[i] : processing->applyProcessing(data->values[i], i));
+            return serialFrame.finish();
+        }
+
+        /**
+         * @brief Find the data with the given sequence number, or the oldest one if it was removed already.
+         *
+         * Sequence numbers in the list are contiguous, so the position is calculated and walked to from the nearer end.
+         *
+         * @param seq The sequence number.
+         * @return The node, nullptr if the sequence number is newer than the newest data.
+         */
+        Node* findBySeq(uint32_t seq) {
+            if ((head == nullptr) || (seq > tail->dataStruct->seq))
+                return nullptr;
+            if (seq <= head->dataStruct->seq)
+                return head;
+            uint16_t fromHead = seq - head->dataStruct->seq;
+            uint16_t fromTail = tail->dataStruct->seq - seq;
+            Node* current = (fromHead <= fromTail) ? head : tail;
+            for (uint16_t i = 0; i < min(fromHead, fromTail); i++)
+                current = (fromHead <= fromTail) ? current->next : current->prev;
+            return current;
+        }
+
+        /**
+         * @brief Find the oldest data newer than the given time.
+         *
+         * Walks back from the newest data, so the effort is proportional to the number of newer data, typically what is requested next.
+         *
+         * @param time The time in ms.
+         * @return The node, nullptr if there is no newer data.
+         */
+        Node* findAfterTime(uint64_t time) {
+            Node* found = nullptr;
+            for (Node* current = tail; (current != nullptr) && (current->dataStruct->time > time); current = current->prev)
+                found = current;
+            return found;
+        }
+
+        size_t nodeToCsvBuffer(Node* node, uint8_t columnCount, DataProcessing *processing, boolean withTime = true, const ChannelMask* mask = nullptr) {
+            // Return empty string if node is empty or the buffer is not initialized yet
+            if (csvBuffer == nullptr)
+                return 0;
+            csvBuffer[0] = '\0';
+            if (node == nullptr)
+                return 0;
+
+            // Integers are converted directly, no printf parsing per value
+            StringBuilder csv(csvBuffer, csvBufferSize);
+            // Time is from millis() and fits into 32 bits
+            if (withTime)
+                csv.appendUint(node->dataStruct->time).append(';');
+            // Nothing to output for an empty record, the last index below would wrap around
+            if (node->dataStruct->value_size == 0)
+                return csv.length();
+            // Selected channels are output as a single row
+            uint8_t last = node->dataStruct->value_size - 1;
+            if (mask != nullptr) {
+                columnCount = std::numeric_limits<uint8_t>::max();
+                while ((last > 0) && !mask->isSet(last))
+                    last--;
             }
-            for (uint8_t i = 0; i < node->dataStruct->value_size; i++) {
-                str += (processing == nullptr) ? node->dataStruct->values[i] : processing->applyProcessing(node->dataStruct->values[i], i);
-                str += (i == node->dataStruct->value_size - 1) || ((i + 1) % columnCount == 0) ? ";" : ",";
+            for (uint8_t i = 0; (i <= last) && !csv.isTruncated(); i++) {
+                if ((mask != nullptr) && !mask->isSet(i))
+                    continue;
+                int32_t value = (processing == nullptr) ? node->dataStruct->values[i] : processing->applyProcessing(node->dataStruct->values[i], i);
+                char separator = (i == last) || ((i + 1) % columnCount == 0) ? ';' : ',';
+                csv.appendInt(value).append(separator);
             }
-            return str;
+            return csv.length();
         }
 
     };
@@ -87,6 +276,7 @@ struct DataCollection {
     uint8_t avgCounter = 0; // Counter for averaging
     int64_t avgStartTime = 0; // Time of first measurement in averaging cycle
     boolean avgCycleFinished = false; // Flag for new data added to dataStore
+    uint32_t countSamples = 0; // Samples added since boot, before averaging
 
     // Data statistics
     NumberArrayLateInit<int32_t> dataMax;
@@ -97,6 +287,7 @@ struct DataCollection {
 
     void initDataValueSize(uint8_t dataValueSize) {
         processing.initDataValueSize(dataValueSize);
+        linkedListSensor.initOutputBuffers(dataValueSize);
         // Init all NumberArrayLateInits
         avgDataSum.lateInit(dataValueSize, 0);
         dataMax.lateInit(dataValueSize, std::numeric_limits<int32_t>::min());
@@ -136,6 +327,7 @@ struct DataCollection {
 
     void addSample(int32_t *newSample) {
         // This is the function to do most of the work
+        countSamples++;
 
         // Add new values to existing sums, remember max/min extremes
         avgDataSum.loopArray([&](int32_t& value, uint8_t i) { value += newSample[i]; } ); // Add new value for later averaging
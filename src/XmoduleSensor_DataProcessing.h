@@ -87,6 +87,27 @@ struct DataProcessing : public JsonInterface {
     }
 
 
+    void exportToBinary(TlvWriter &tlv) {
+        // No need to save if values are default
+        if (!offset.isDefault())
+            tlv.writeInt32Array(_helper.hashStringDjb2("offset"), offset.values, offset.value_size);
+        if (!scaling.isDefault())
+            tlv.writeFloatArray(_helper.hashStringDjb2("scaling"), scaling.values, scaling.value_size);
+    }
+
+    bool importFromBinary(TlvReader &tlv) {
+        // Assigns values only if the record exists, the size needs to match to not have memory issues
+        bool success = true;
+        while (tlv.next()) {
+            if ((tlv.key == _helper.hashStringDjb2("offset")) && (tlv.type == TLV_INT32_ARRAY))
+                success &= tlv.asArray(offset.values, offset.value_size);
+            if ((tlv.key == _helper.hashStringDjb2("scaling")) && (tlv.type == TLV_FLOAT_ARRAY))
+                success &= tlv.asArray(scaling.values, scaling.value_size);
+        }
+        return success && !tlv.error;
+    }
+
+
 //////////////////////////////////////////////////////////////////////////////////
 
     void setOffset(int32_t* offsetMeasurement) {
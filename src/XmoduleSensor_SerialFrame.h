@@ -0,0 +1,132 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MVP3000_XMODULESENSOR_SERIALFRAME
+#define MVP3000_XMODULESENSOR_SERIALFRAME
+
+#include <Arduino.h>
+
+
+/**
+ * @brief Binary frame of a single measurement for the serial port, with sequence number, raw int32 values, CRC-32, and COBS framing.
+ *
+ * Layout before encoding, little-endian: type (1), sequence number (4), time in ms (4), column count (1), value count (1), values (4 each), CRC-32 of all bytes before (4).
+ * COBS removes all zero bytes from the frame. The encoded frame starts and ends with a zero byte, so log text written between frames stays separable.
+ * The buffers are allocated once when the number of values is known.
+ */
+struct SerialFrameWriter {
+
+    static const uint8_t TYPE_MEASUREMENT = 1;
+
+    uint32_t countFrames = 0;
+
+    ~SerialFrameWriter() { delete[] payload; delete[] frame; }
+
+    void init(uint8_t valueCount) {
+        payloadSize = 11 + 4 * valueCount + 4;
+        // One code byte per started block of 254 bytes, two delimiters
+        frameSize = payloadSize + payloadSize / 254 + 3;
+        delete[] payload;
+        payload = new uint8_t[payloadSize];
+        delete[] frame;
+        frame = new uint8_t[frameSize];
+    }
+
+    void begin(uint32_t seq, uint32_t time_ms, uint8_t columnCount, uint8_t valueCount) {
+        length = 0;
+        writeByte(TYPE_MEASUREMENT);
+        writeUint32(seq);
+        writeUint32(time_ms);
+        writeByte(columnCount);
+        writeByte(valueCount);
+    }
+
+    void addValue(int32_t value) { writeUint32((uint32_t)value); }
+
+    /**
+     * @brief Append the checksum and encode the frame.
+     *
+     * @return Length of the encoded frame, 0 if the values did not fit.
+     */
+    size_t finish() {
+        if (length + 4 > payloadSize)
+            return 0;
+        writeUint32(crc32(payload, length));
+        countFrames++;
+        return encode();
+    }
+
+    const uint8_t* getFrame() const { return frame; }
+
+    private:
+
+        uint8_t* payload = nullptr;
+        size_t payloadSize = 0;
+        size_t length = 0;
+        uint8_t* frame = nullptr;
+        size_t frameSize = 0;
+
+        void writeByte(uint8_t value) {
+            if (length < payloadSize)
+                payload[length] = value;
+            length++;
+        }
+
+        void writeUint32(uint32_t value) {
+            for (uint8_t i = 0; i < 4; i++)
+                writeByte(value >> (8 * i));
+        }
+
+        // CRC-32 as used by zlib and Ethernet, four bits per step with a small table
+        static uint32_t crc32(const uint8_t* data, size_t dataLength) {
+            static const uint32_t table[16] = { 0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+            uint32_t crc = 0xFFFFFFFF;
+            for (size_t i = 0; i < dataLength; i++) {
+                crc ^= data[i];
+                crc = (crc >> 4) ^ table[crc & 0x0F];
+                crc = (crc >> 4) ^ table[crc & 0x0F];
+            }
+            return ~crc;
+        }
+
+        size_t encode() {
+            // Each block starts with a code byte: the distance to the next zero, 0xFF for 254 bytes without zero
+            size_t out = 0;
+            frame[out++] = 0;
+            size_t codeIndex = out++;
+            uint8_t code = 1;
+            for (size_t i = 0; i < length; i++) {
+                if (payload[i] == 0) {
+                    frame[codeIndex] = code;
+                    codeIndex = out++;
+                    code = 1;
+                    continue;
+                }
+                frame[out++] = payload[i];
+                code++;
+                if (code == 0xFF) {
+                    frame[codeIndex] = code;
+                    codeIndex = out++;
+                    code = 1;
+                }
+            }
+            frame[codeIndex] = code;
+            frame[out++] = 0;
+            return out;
+        }
+};
+
+#endif
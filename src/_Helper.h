@@ -19,6 +19,7 @@ limitations under the License.
 
 #include <Arduino.h>
 
+#include "_Helper_StringBuilder.h"
 
 struct _Helper {
 
@@ -92,14 +93,8 @@ struct _Helper {
      * @return Time string in the format "d hh:mm:ss"
      */
     String millisToTime(uint64_t total_ms)  {
-        uint64_t total_s = total_ms / 1000;
-        uint16_t days = total_s / 86400; // 24*60*60
-        uint32_t remaining_s = total_s % 86400;
-        uint8_t hours = remaining_s / 3600; // 60*60
-        remaining_s = total_s % 3600;
-        uint8_t minutes = remaining_s / 60;
-        uint8_t seconds = remaining_s % 60;
-        return printFormatted("%dd %02d:%02d:%02d", days, hours, minutes, seconds);
+        StringBuffer<24> time;
+        return time.appendTime(total_ms).c_str();
     }
 
 
@@ -108,6 +103,8 @@ struct _Helper {
     /**
      * @brief Print a formatted string
      *
+     * Allocates the result, use a StringBuilder for output that is generated repeatedly.
+     *
      * @param formatString Format string
      * @param ... Arguments
      *
@@ -116,18 +113,25 @@ struct _Helper {
     String printFormatted(const String& formatString, ...) {
         va_list args;
         va_start(args, formatString);
+        va_list argsRetry;
+        va_copy(argsRetry, args);
+
+        // Most results fit the stack buffer, only longer ones are formatted a second time
+        char buffer[96];
+        int len = vsnprintf(buffer, sizeof(buffer), formatString.c_str(), args);
+        String result;
+        if (len >= (int)sizeof(buffer)) {
+            char* large = new char[len + 1];
+            vsnprintf(large, len + 1, formatString.c_str(), argsRetry);
+            result = large;
+            delete[] large;
+        } else if (len > 0) {
+            result = buffer;
+        }
 
-        // Get length incl termination
-        uint8_t len = vsnprintf(nullptr, 0, formatString.c_str(), args) + 1;
-        char buffer[len];
-        vsnprintf(buffer, len, formatString.c_str(), args);
-
+        va_end(argsRetry);
         va_end(args);
-        return buffer;
-
-        // There is no try-catch in ESP, workaround
-        // __try { }
-        // __catch(int e) { } // This just continues quietly
+        return result;
     }
 
 
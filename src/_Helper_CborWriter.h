@@ -0,0 +1,105 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MVP3000_HELPER_CBORWRITER
+#define MVP3000_HELPER_CBORWRITER
+
+#include <Arduino.h>
+
+
+/**
+ * @brief Minimal CBOR (RFC 8949) encoder writing into a caller-provided buffer, it never allocates memory.
+ *
+ * Only the types needed for sensor data are supported: integers, text strings, arrays and maps of known length.
+ * Writing beyond the buffer sets the overflow flag, the content is invalid then.
+ *
+ * @param buffer The buffer to write to.
+ * @param capacity The size of the buffer.
+ */
+struct CborWriter {
+
+    uint8_t* buffer;
+    size_t capacity;
+    size_t length = 0;
+    boolean overflow = false;
+
+    CborWriter(uint8_t* buffer, size_t capacity) : buffer(buffer), capacity(capacity) { }
+
+    /**
+     * @brief Upper bound of the encoded size of a single integer.
+     */
+    static const uint8_t MAX_INT_SIZE = 9;
+
+    void writeUint(uint64_t value) { writeTypeValue(0, value); }
+
+    void writeInt(int64_t value) {
+        // Negative integers are encoded as -1 - n
+        if (value < 0)
+            writeTypeValue(1, -1 - value);
+        else
+            writeTypeValue(0, value);
+    }
+
+    void writeText(const char* text) {
+        size_t len = strlen(text);
+        writeTypeValue(3, len);
+        writeBytes((const uint8_t*)text, len);
+    }
+
+    void writeArrayHeader(size_t count) { writeTypeValue(4, count); }
+    void writeMapHeader(size_t count) { writeTypeValue(5, count); }
+
+    private:
+
+        void writeTypeValue(uint8_t majorType, uint64_t value) {
+            majorType <<= 5;
+            if (value < 24) {
+                writeByte(majorType | value);
+            } else if (value <= 0xFF) {
+                writeByte(majorType | 24);
+                writeByte(value);
+            } else if (value <= 0xFFFF) {
+                writeByte(majorType | 25);
+                writeBigEndian(value, 2);
+            } else if (value <= 0xFFFFFFFF) {
+                writeByte(majorType | 26);
+                writeBigEndian(value, 4);
+            } else {
+                writeByte(majorType | 27);
+                writeBigEndian(value, 8);
+            }
+        }
+
+        void writeBigEndian(uint64_t value, uint8_t bytes) {
+            for (int8_t i = bytes - 1; i >= 0; i--)
+                writeByte(value >> (8 * i));
+        }
+
+        void writeByte(uint8_t b) {
+            if (length >= capacity) {
+                overflow = true;
+                return;
+            }
+            buffer[length++] = b;
+        }
+
+        void writeBytes(const uint8_t* data, size_t len) {
+            for (size_t i = 0; i < len; i++)
+                writeByte(data[i]);
+        }
+};
+
+#endif
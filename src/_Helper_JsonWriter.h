@@ -0,0 +1,118 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MVP3000_HELPER_JSONWRITER
+#define MVP3000_HELPER_JSONWRITER
+
+#include <Arduino.h>
+
+
+/**
+ * @brief Minimal streaming JSON writer, every token is printed directly to the output without building a document.
+ *
+ * Separators are inserted automatically. Inside an object each value is preceded by writeKey().
+ *
+ * @param out The output to write to, typically the response stream of the web server.
+ */
+struct JsonWriter {
+
+    Print& out;
+
+    JsonWriter(Print& out) : out(out) { }
+
+    void beginObject() { beginValue(); out.write('{'); push(); }
+    void endObject() { pop(); out.write('}'); }
+    void beginArray() { beginValue(); out.write('['); push(); }
+    void endArray() { pop(); out.write(']'); }
+
+    void writeKey(const char* key) {
+        beginValue();
+        writeEscaped(key);
+        out.write(':');
+        keyPending = true;
+    }
+
+    void writeUint(uint32_t value) { beginValue(); out.print((unsigned long)value); }
+    void writeInt(int32_t value) { beginValue(); out.print((long)value); }
+    void writeFloat(float value, uint8_t decimals = 2) {
+        beginValue();
+        if (isnan(value) || isinf(value))
+            out.print("null"); // Not valid in JSON
+        else
+            out.print(value, decimals);
+    }
+    void writeBool(boolean value) { beginValue(); out.print(value ? "true" : "false"); }
+    void writeNull() { beginValue(); out.print("null"); }
+    void writeText(const char* text) { beginValue(); writeEscaped(text); }
+    void writeText(const String& text) { writeText(text.c_str()); }
+
+    // Shortcuts for object members
+    void writeUint(const char* key, uint32_t value) { writeKey(key); writeUint(value); }
+    void writeInt(const char* key, int32_t value) { writeKey(key); writeInt(value); }
+    void writeFloat(const char* key, float value, uint8_t decimals = 2) { writeKey(key); writeFloat(value, decimals); }
+    void writeBool(const char* key, boolean value) { writeKey(key); writeBool(value); }
+    void writeText(const char* key, const char* text) { writeKey(key); writeText(text); }
+    void writeText(const char* key, const String& text) { writeKey(key); writeText(text.c_str()); }
+
+    private:
+
+        // One bit per nesting level, set if the level already has an element and the next one needs a comma
+        uint32_t hasElement = 0;
+        uint8_t depth = 0;
+        boolean keyPending = false;
+
+        void push() {
+            depth++;
+            hasElement &= ~(1UL << depth);
+        }
+
+        void pop() { depth--; }
+
+        void beginValue() {
+            // The value of a key has no separator, the key had it
+            if (keyPending) {
+                keyPending = false;
+                return;
+            }
+            if (hasElement & (1UL << depth))
+                out.write(',');
+            hasElement |= (1UL << depth);
+        }
+
+        void writeEscaped(const char* text) {
+            out.write('"');
+            for (const char* c = text; *c != '\0'; c++) {
+                switch (*c) {
+                    case '"': out.print("\\\""); break;
+                    case '\\': out.print("\\\\"); break;
+                    case '\n': out.print("\\n"); break;
+                    case '\r': out.print("\\r"); break;
+                    case '\t': out.print("\\t"); break;
+                    default:
+                        if ((uint8_t)*c < 0x20) {
+                            char escaped[7];
+                            snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+                            out.print(escaped);
+                        } else {
+                            out.write(*c);
+                        }
+                }
+            }
+            out.write('"');
+        }
+};
+
+#endif
@@ -58,12 +58,30 @@ struct LinkedList3000 {
     T* getNewestData() { return tail->dataStruct; }
     T* getOldestData() { return head->dataStruct; }
 
+    /**
+     * @brief Get the data at the given index without changing the list, for example for a cursor that is kept outside the list.
+     *
+     * @param index The index of the node, starting from zero.
+     * @param reverse (optional) Start from the newest/tail entry towards the oldest/head entry. Default is false.
+     * @return The data, nullptr if the index is out of bounds.
+     */
+    T* getDataByIndex(uint16_t index, boolean reverse = false) {
+        if (index >= size)
+            return nullptr;
+        Node* current = (reverse) ? tail : head;
+        for (uint16_t i = 0; i < index; i++)
+            current = (reverse) ? current->prev : current->next;
+        return current->dataStruct;
+    }
+
     uint16_t size;
     uint16_t max_size;
 
     uint16_t getSize() const { return size; }
     uint16_t getMaxSize() const { return max_size; }
 
+    uint32_t countEvicted = 0; // Oldest nodes removed because the list was full
+
 
     /**
      * @brief Constructor with a maximum list size limit.
@@ -90,6 +108,7 @@ struct LinkedList3000 {
         // Check if size limit is reached and cannot be grown, then remove the oldest node
         if (size >= max_size) {
             _removeNode(head);
+            countEvicted++;
         }
         // Append the new node
         Node* newNode = new Node(newDataStruct);
@@ -0,0 +1,184 @@
+/*
+Copyright Production 3000
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#ifndef MVP3000_HELPER_STRINGBUILDER
+#define MVP3000_HELPER_STRINGBUILDER
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+
+/**
+ * @brief Appends text and numbers to a fixed buffer without allocating memory.
+ *
+ * Text beyond the capacity is cut, the content is always null-terminated. Integers and fixed-point numbers are converted directly, printf formatting is available for everything else.
+ *
+ * @param buffer The buffer to write to, needs to stay valid.
+ * @param capacity The size of the buffer including the termination.
+ */
+struct StringBuilder {
+
+    StringBuilder(char* buffer, size_t capacity) : buffer(buffer), capacity(capacity) { clear(); }
+
+    void clear() {
+        len = 0;
+        truncated = false;
+        buffer[0] = '\0';
+    }
+
+    const char* c_str() const { return buffer; }
+    size_t length() const { return len; }
+    // Some text did not fit
+    boolean isTruncated() const { return truncated; }
+
+    StringBuilder& append(const char* text) { return append(text, strlen(text)); }
+    StringBuilder& append(const String& text) { return append(text.c_str(), text.length()); }
+    StringBuilder& append(char c) { return append(&c, 1); }
+
+    StringBuilder& append(const char* text, size_t textLen) {
+        size_t room = capacity - 1 - len;
+        if (textLen > room) {
+            textLen = room;
+            truncated = true;
+        }
+        memcpy(buffer + len, text, textLen);
+        len += textLen;
+        buffer[len] = '\0';
+        return *this;
+    }
+
+    /**
+     * @brief Append an unsigned integer.
+     *
+     * @param value The value.
+     * @param width (optional) Minimum number of characters, filled up with pad in front.
+     * @param pad (optional) Fill character, for example '0' for 07.
+     */
+    StringBuilder& appendUint(uint32_t value, uint8_t width = 0, char pad = ' ') {
+        char digits[10]; // Max 4294967295
+        char* start = digits + sizeof(digits);
+        do {
+            *--start = '0' + (value % 10);
+            value /= 10;
+        } while (value > 0);
+        uint8_t count = digits + sizeof(digits) - start;
+        for (; count < width; count++)
+            append(pad);
+        return append(start, digits + sizeof(digits) - start);
+    }
+
+    StringBuilder& appendInt(int32_t value) {
+        if (value >= 0)
+            return appendUint(value);
+        append('-');
+        return appendUint(0UL - (uint32_t)value); // Also works for the lowest value
+    }
+
+    /**
+     * @brief Append a fixed-point number stored as an integer, for example 1234 with 2 decimals is 12.34.
+     *
+     * @param value The value multiplied by 10^decimals.
+     * @param decimals Number of decimal places, up to 9.
+     */
+    StringBuilder& appendFixed(int32_t value, uint8_t decimals) {
+        uint32_t scale = 1;
+        for (uint8_t i = 0; i < decimals; i++)
+            scale *= 10;
+        uint32_t magnitude = (value < 0) ? 0UL - (uint32_t)value : value;
+        if (value < 0)
+            append('-');
+        appendUint(magnitude / scale);
+        if (decimals == 0)
+            return *this;
+        append('.');
+        return appendUint(magnitude % scale, decimals, '0');
+    }
+
+    // Rounded to the given decimals, through fixed-point if the value is in range
+    StringBuilder& appendFloat(float value, uint8_t decimals = 2) {
+        float scale = 1;
+        for (uint8_t i = 0; i < decimals; i++)
+            scale *= 10;
+        float scaled = value * scale;
+        // Beyond 2^24 a float does not hold every integer, the digits would be made up, and 2^31 would overflow lroundf()
+        if (isnan(scaled) || (scaled >= 16777216.0f) || (scaled <= -16777216.0f))
+            return appendFormatted("%.*f", decimals, value);
+        return appendFixed(lroundf(scaled), decimals);
+    }
+
+    // Milliseconds as time string "d hh:mm:ss"
+    StringBuilder& appendTime(uint64_t total_ms) {
+        uint64_t total_s = total_ms / 1000;
+        appendUint(total_s / 86400); // 24*60*60
+        append("d ");
+        appendUint((total_s % 86400) / 3600, 2, '0');
+        append(':');
+        appendUint((total_s % 3600) / 60, 2, '0');
+        append(':');
+        return appendUint(total_s % 60, 2, '0');
+    }
+
+    StringBuilder& appendFormatted(const char* formatString, ...) {
+        va_list args;
+        va_start(args, formatString);
+        appendFormattedV(formatString, args);
+        va_end(args);
+        return *this;
+    }
+
+    // Single pass, the output is cut at the capacity
+    StringBuilder& appendFormattedV(const char* formatString, va_list args) {
+        int written = vsnprintf(buffer + len, capacity - len, formatString, args);
+        if (written < 0)
+            return *this;
+        if ((size_t)written >= capacity - len) {
+            len = capacity - 1;
+            truncated = true;
+        } else {
+            len += written;
+        }
+        return *this;
+    }
+
+    private:
+
+        char* buffer;
+        size_t capacity;
+        size_t len;
+        boolean truncated;
+};
+
+
+/**
+ * @brief StringBuilder with its own storage, typically on the stack.
+ *
+ * @tparam N The size of the storage including the termination.
+ */
+template <size_t N>
+struct StringBuffer : StringBuilder {
+    StringBuffer() : StringBuilder(storage, N) { }
+
+    // Copies would point to the storage of the original
+    StringBuffer(const StringBuffer&) = delete;
+    StringBuffer& operator=(const StringBuffer&) = delete;
+
+    private:
+
+        char storage[N];
+};
+
+#endif
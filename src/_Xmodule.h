@@ -43,6 +43,8 @@ class _Xmodule {
         virtual void loop() { };
 
         virtual String webPageProcessor(uint8_t var) { return ""; };
+        // Rows of a list placeholder, called with increasing index until it returns false
+        virtual boolean webPageListProcessor(uint8_t var, uint16_t index, String& row) { return false; };
         // We cannot override the values, but we can override this function.
         virtual const char* getWebPage() { return ""; };
 